@@ -1,13 +1,14 @@
 // aeroboo.c
 //
 // "aeroboo" with splash, entry screen, and game in a single executable.
-// Requires SDL2, SDL2_image and SDL2_mixer.
+// Requires SDL2 (2.0.18 or later), SDL2_image and SDL2_mixer.
 
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_mixer.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 // Window dimensions
@@ -33,6 +34,34 @@ const float  PROJECTILE_SPEED  = 600.0f;
 const double EXPLOSION_TIME    = 0.5;
 const double WINNER_TIME       = 2.0;
 
+// Sky behind the game
+static const SDL_Color SKY_COLOR = { 135, 206, 235, 255 };
+
+// On-screen sprite widths; sprites are resampled to this size at load time
+#define BIRD_DRAW_W    128
+#define CANNON_DRAW_W   96
+#define WINNER_DRAW_W  400
+
+// Game sprites, in load order
+enum { SPR_BU1, SPR_BU2, SPR_CANO1, SPR_CANO2, SPR_CANO3,
+       SPR_EXPLOSION, SPR_WINNER, SPR_COUNT };
+
+typedef struct {
+    const char *file;
+    int         draw_w;     // width on screen, height keeps the source aspect
+    int         like;       // or drawn in the same rect as this sprite (-1: none)
+} SpriteDef;
+
+static const SpriteDef SPRITES[SPR_COUNT] = {
+    [SPR_BU1]       = { "bu1.png",       BIRD_DRAW_W,   -1      },
+    [SPR_BU2]       = { "bu2.png",       BIRD_DRAW_W,   SPR_BU1 },
+    [SPR_CANO1]     = { "cano1.png",     CANNON_DRAW_W, -1      },
+    [SPR_CANO2]     = { "cano2.png",     CANNON_DRAW_W, -1      },
+    [SPR_CANO3]     = { "cano3.png",     CANNON_DRAW_W, -1      },
+    [SPR_EXPLOSION] = { "explosion.png", BIRD_DRAW_W,   SPR_BU1 },
+    [SPR_WINNER]    = { "winner.png",    WINNER_DRAW_W, -1      },
+};
+
 // Clamp integer into Uint8 range [0,255]
 static Uint8 clamp_u8(int v) {
     if (v <   0) return   0;
@@ -40,170 +69,4662 @@ static Uint8 clamp_u8(int v) {
     return (Uint8)v;
 }
 
-// Convert any surface to RGBA32 format
-static SDL_Surface* convert_to_rgba32(SDL_Surface* s) {
-    if (!s) return NULL;
-    return SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_RGBA32, 0);
+// Convert any surface to RGBA32 format
+static SDL_Surface* convert_to_rgba32(SDL_Surface* s) {
+    if (!s) return NULL;
+    return SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_RGBA32, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Worker pool
+//
+// A handful of threads kept alive for the whole run so that per-image work
+// (backdrop removal, scaling) can be split into row bands without paying
+// thread creation on every call. The calling thread takes part in the work.
+// ---------------------------------------------------------------------------
+
+#define POOL_MAX_WORKERS 16
+
+typedef void (*PoolBandFn)(void *ctx, int band, int nbands);
+
+static struct {
+    SDL_Thread  *th[POOL_MAX_WORKERS];
+    int          n;
+    SDL_sem     *start, *done;
+    SDL_mutex   *lock;
+    PoolBandFn   fn;
+    void        *ctx;
+    int          nbands;
+    SDL_atomic_t next;
+    int          quit;
+    SDL_atomic_t state;         // POOL_* below
+} pool;
+
+enum { POOL_OFF, POOL_STARTING, POOL_READY };
+
+// Pull bands until none are left
+static void pool_drain(void) {
+    for (;;) {
+        int band = SDL_AtomicAdd(&pool.next, 1);
+        if (band >= pool.nbands) break;
+        pool.fn(pool.ctx, band, pool.nbands);
+    }
+}
+
+static int pool_worker(void *unused) {
+    (void)unused;
+    for (;;) {
+        SDL_SemWait(pool.start);
+        if (pool.quit) break;
+        pool_drain();
+        SDL_SemPost(pool.done);
+    }
+    return 0;
+}
+
+// Start one worker per extra CPU; returns the number of workers running.
+// The first caller starts them; the loader, the hot-reload thread and the
+// main thread may all get here at once, so the others wait until it is done.
+static int pool_init(void) {
+    if (!SDL_AtomicCAS(&pool.state, POOL_OFF, POOL_STARTING)) {
+        while (SDL_AtomicGet(&pool.state) != POOL_READY) SDL_Delay(0);
+        return pool.n;
+    }
+    pool.lock  = SDL_CreateMutex();
+    pool.start = SDL_CreateSemaphore(0);
+    pool.done  = SDL_CreateSemaphore(0);
+    if (pool.lock && pool.start && pool.done) {
+        int want = SDL_GetCPUCount() - 1;
+        if (want > POOL_MAX_WORKERS) want = POOL_MAX_WORKERS;
+        for (int i = 0; i < want; i++) {
+            pool.th[pool.n] = SDL_CreateThread(pool_worker, "aeroboo-pool", NULL);
+            if (!pool.th[pool.n]) break;
+            pool.n++;
+        }
+    }
+    SDL_AtomicSet(&pool.state, POOL_READY);
+    return pool.n;
+}
+
+// Stop the workers; only once every thread that used the pool is done
+static void pool_shutdown(void) {
+    if (SDL_AtomicGet(&pool.state) != POOL_READY) return;
+    pool.quit = 1;
+    for (int i = 0; i < pool.n; i++) SDL_SemPost(pool.start);
+    for (int i = 0; i < pool.n; i++) SDL_WaitThread(pool.th[i], NULL);
+    SDL_DestroySemaphore(pool.start);
+    SDL_DestroySemaphore(pool.done);
+    SDL_DestroyMutex(pool.lock);
+    SDL_zero(pool);
+}
+
+// Run fn over nbands bands on the pool and the calling thread, then return
+static void pool_parallel_for(PoolBandFn fn, void *ctx, int nbands) {
+    if (nbands <= 0) return;
+    if (nbands == 1 || pool_init() == 0) {
+        for (int i = 0; i < nbands; i++) fn(ctx, i, nbands);
+        return;
+    }
+    SDL_LockMutex(pool.lock);
+    pool.fn     = fn;
+    pool.ctx    = ctx;
+    pool.nbands = nbands;
+    SDL_AtomicSet(&pool.next, 0);
+    int helpers = pool.n < nbands - 1 ? pool.n : nbands - 1;
+    for (int i = 0; i < helpers; i++) SDL_SemPost(pool.start);
+    pool_drain();
+    for (int i = 0; i < helpers; i++) SDL_SemWait(pool.done);
+    SDL_UnlockMutex(pool.lock);
+}
+
+// Instruction sets the vector kernels (backdrop removal, sparks, software
+// compositor) are built for; ISA_BEST asks for the widest one available
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ISA_HAVE_X86 1
+#endif
+
+enum { ISA_SCALAR, ISA_SSE2, ISA_AVX2, ISA_BEST };
+
+// Pick the widest kernel the CPU supports
+static int cpu_best_isa(void) {
+#ifdef ISA_HAVE_X86
+    if (SDL_HasAVX2()) return ISA_AVX2;
+    if (SDL_HasSSE2()) return ISA_SSE2;
+#endif
+    return ISA_SCALAR;
+}
+
+// ---------------------------------------------------------------------------
+// Backdrop removal kernels
+//
+// The alpha ramp only depends on d = max(|r-bg_r|, |g-bg_g|, |b-bg_b|), and
+// the un-premultiplied colour only on (d, channel value, backdrop channel).
+// Tabulating the original float expressions once per image turns the
+// per-pixel division into lookups, so every path is bit-identical to
+// make_sprite_from_bg_ref(). Pixels at or below `low` become the backdrop
+// colour with zero alpha, pixels at or above `high` keep their colour and
+// become opaque; SIMD paths handle runs of either case a vector at a time.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    Uint8 *pix;              // RGBA32 bytes
+    int    w, h, pitch;
+    int    low, high;
+    Uint8  bg[3];
+    Uint8  alpha[256];       // output alpha per distance d
+    Uint8 *ramp;             // [d-low-1][channel][value] for low < d < high
+    int    isa;
+} DesblendJob;
+
+// Reference implementation: the original per-pixel float loop
+static void make_sprite_from_bg_ref(SDL_Surface* s, Uint8 bg_r, Uint8 bg_g, Uint8 bg_b,
+                                    int low, int high) {
+    Uint8 *B = (Uint8*)s->pixels;
+    for (int i = 0, tot = s->w * s->h; i < tot; i++) {
+        Uint8 r = B[4*i+0], g = B[4*i+1], b = B[4*i+2];
+        int dr = abs(r - bg_r), dg = abs(g - bg_g), db = abs(b - bg_b);
+        int d = dr>dg?dr:dg; d = db>d?db:d;
+        float a = (d <= low ? 0.0f
+                   : (d >= high ? 1.0f : (float)(d-low)/(high-low)));
+        Uint8 outA = clamp_u8((int)(255*a + .5f));
+        Uint8 outR, outG, outB;
+        if (a <= 0.0f) {
+            outR = bg_r; outG = bg_g; outB = bg_b;
+        } else {
+            outR = clamp_u8((int)(((r - (1.f - a)*bg_r)/a) + .5f));
+            outG = clamp_u8((int)(((g - (1.f - a)*bg_g)/a) + .5f));
+            outB = clamp_u8((int)(((b - (1.f - a)*bg_b)/a) + .5f));
+        }
+        ((Uint32*)B)[i] = SDL_MapRGBA(s->format, outR, outG, outB, outA);
+    }
+}
+
+// Build the alpha and un-premultiply tables; returns 0 on allocation failure
+static int desblend_build_tables(DesblendJob *j) {
+    int steps = j->high - j->low - 1;
+    j->ramp = NULL;
+    for (int d = 0; d < 256; d++) {
+        float a = (d <= j->low ? 0.0f
+                   : (d >= j->high ? 1.0f : (float)(d - j->low)/(j->high - j->low)));
+        j->alpha[d] = clamp_u8((int)(255*a + .5f));
+    }
+    if (steps <= 0) return 1;
+    j->ramp = (Uint8*)malloc((size_t)steps * 3 * 256);
+    if (!j->ramp) return 0;
+    for (int k = 0; k < steps; k++) {
+        float a = (float)(k + 1)/(j->high - j->low);
+        for (int c = 0; c < 3; c++) {
+            Uint8 *row = j->ramp + ((size_t)k*3 + c) * 256;
+            for (int v = 0; v < 256; v++)
+                row[v] = clamp_u8((int)(((v - (1.f - a)*j->bg[c])/a) + .5f));
+        }
+    }
+    return 1;
+}
+
+static inline void desblend_pixel(const DesblendJob *j, Uint8 *p) {
+    int dr = abs(p[0] - j->bg[0]), dg = abs(p[1] - j->bg[1]), db = abs(p[2] - j->bg[2]);
+    int d = dr>dg?dr:dg; d = db>d?db:d;
+    if (d <= j->low) {
+        p[0] = j->bg[0]; p[1] = j->bg[1]; p[2] = j->bg[2]; p[3] = 0;
+    } else if (d >= j->high) {
+        p[3] = 255;
+    } else {
+        const Uint8 *t = j->ramp + (size_t)(d - j->low - 1) * 3 * 256;
+        p[0] = t[p[0]]; p[1] = t[256 + p[1]]; p[2] = t[512 + p[2]];
+        p[3] = j->alpha[d];
+    }
+}
+
+static void desblend_row_scalar(const DesblendJob *j, Uint8 *row, int w) {
+    for (int x = 0; x < w; x++) desblend_pixel(j, row + 4*x);
+}
+
+#ifdef ISA_HAVE_X86
+__attribute__((target("sse2")))
+static void desblend_row_sse2(const DesblendJob *j, Uint8 *row, int w) {
+    Uint32 bgpix = (Uint32)j->bg[0] | (Uint32)j->bg[1] << 8 | (Uint32)j->bg[2] << 16;
+    const __m128i bg    = _mm_set1_epi32((int)bgpix);
+    const __m128i rgb   = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i opq   = _mm_set1_epi32((int)0xFF000000u);
+    const __m128i lo    = _mm_set1_epi32(j->low);
+    const __m128i hi    = _mm_set1_epi32(j->high - 1);
+    int x = 0;
+    for (; x + 4 <= w; x += 4) {
+        __m128i p  = _mm_loadu_si128((const __m128i*)(row + 4*x));
+        __m128i ad = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(p, bg), _mm_subs_epu8(bg, p)), rgb);
+        __m128i m  = _mm_max_epu8(ad, _mm_srli_epi32(ad, 8));
+        m = _mm_and_si128(_mm_max_epu8(m, _mm_srli_epi32(ad, 16)), _mm_set1_epi32(0xFF));
+        int clear = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(m, lo)));
+        int solid = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(m, hi)));
+        if (clear == 0) {
+            _mm_storeu_si128((__m128i*)(row + 4*x), bg);
+        } else if (solid == 0xF) {
+            _mm_storeu_si128((__m128i*)(row + 4*x), _mm_or_si128(p, opq));
+        } else {
+            for (int k = 0; k < 4; k++) desblend_pixel(j, row + 4*(x + k));
+        }
+    }
+    desblend_row_scalar(j, row + 4*x, w - x);
+}
+
+__attribute__((target("avx2")))
+static void desblend_row_avx2(const DesblendJob *j, Uint8 *row, int w) {
+    Uint32 bgpix = (Uint32)j->bg[0] | (Uint32)j->bg[1] << 8 | (Uint32)j->bg[2] << 16;
+    const __m256i bg    = _mm256_set1_epi32((int)bgpix);
+    const __m256i rgb   = _mm256_set1_epi32(0x00FFFFFF);
+    const __m256i opq   = _mm256_set1_epi32((int)0xFF000000u);
+    const __m256i lo    = _mm256_set1_epi32(j->low);
+    const __m256i hi    = _mm256_set1_epi32(j->high - 1);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m256i p  = _mm256_loadu_si256((const __m256i*)(row + 4*x));
+        __m256i ad = _mm256_and_si256(_mm256_or_si256(_mm256_subs_epu8(p, bg),
+                                                      _mm256_subs_epu8(bg, p)), rgb);
+        __m256i m  = _mm256_max_epu8(ad, _mm256_srli_epi32(ad, 8));
+        m = _mm256_and_si256(_mm256_max_epu8(m, _mm256_srli_epi32(ad, 16)),
+                             _mm256_set1_epi32(0xFF));
+        int clear = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(m, lo)));
+        int solid = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(m, hi)));
+        if (clear == 0) {
+            _mm256_storeu_si256((__m256i*)(row + 4*x), bg);
+        } else if (solid == 0xFF) {
+            _mm256_storeu_si256((__m256i*)(row + 4*x), _mm256_or_si256(p, opq));
+        } else {
+            for (int k = 0; k < 8; k++) desblend_pixel(j, row + 4*(x + k));
+        }
+    }
+    desblend_row_sse2(j, row + 4*x, w - x);
+}
+#endif
+
+static void desblend_band(void *ctx, int band, int nbands) {
+    const DesblendJob *j = (const DesblendJob*)ctx;
+    int y0 = (int)((long)j->h * band / nbands);
+    int y1 = (int)((long)j->h * (band + 1) / nbands);
+    for (int y = y0; y < y1; y++) {
+        Uint8 *row = j->pix + (size_t)y * j->pitch;
+        switch (j->isa) {
+#ifdef ISA_HAVE_X86
+            case ISA_AVX2: desblend_row_avx2(j, row, j->w);   break;
+            case ISA_SSE2: desblend_row_sse2(j, row, j->w);   break;
+#endif
+            default:       desblend_row_scalar(j, row, j->w); break;
+        }
+    }
+}
+
+// Rows per band: small enough to balance, large enough to amortise dispatch
+#define DESBLEND_BAND_ROWS 64
+
+// Run the backdrop removal on an RGBA32 surface with the given kernel,
+// optionally split into row bands across the worker pool
+static int desblend_surface(SDL_Surface* s, Uint8 bg_r, Uint8 bg_g, Uint8 bg_b,
+                            int low, int high, int isa, int threaded) {
+    DesblendJob j;
+    j.pix   = (Uint8*)s->pixels;
+    j.w     = s->w;
+    j.h     = s->h;
+    j.pitch = s->pitch;
+    j.low   = low;
+    j.high  = high;
+    j.bg[0] = bg_r; j.bg[1] = bg_g; j.bg[2] = bg_b;
+    j.isa   = (isa == ISA_BEST) ? cpu_best_isa() : isa;
+    if (!desblend_build_tables(&j)) return 0;
+
+    int nbands = threaded ? (j.h + DESBLEND_BAND_ROWS - 1) / DESBLEND_BAND_ROWS : 1;
+    pool_parallel_for(desblend_band, &j, nbands);
+    free(j.ramp);
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Sprite resampling
+//
+// Area-average (box) filter with exact fractional coverage, so shrinking a
+// 1024 px sprite to 128 px averages every source pixel once. Colour is
+// weighted by alpha so the transparent backdrop left by make_sprite_from_bg
+// does not bleed into sprite edges. Passes are split into row bands on the
+// worker pool.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int   *first;               // first source index per destination index
+    int   *count;               // number of source taps
+    float *weight;              // [dst][taps], summing to 1
+    int    taps;
+} ResampleAxis;
+
+static int resample_axis_init(ResampleAxis *ax, int src_n, int dst_n) {
+    double scale = (double)src_n / dst_n;
+    ax->taps   = (int)ceil(scale) + 1;
+    ax->first  = (int*)malloc(sizeof(int) * (size_t)dst_n);
+    ax->count  = (int*)malloc(sizeof(int) * (size_t)dst_n);
+    ax->weight = (float*)calloc((size_t)dst_n * ax->taps, sizeof(float));
+    if (!ax->first || !ax->count || !ax->weight) return 0;
+    for (int d = 0; d < dst_n; d++) {
+        double x0 = d * scale, x1 = (d + 1) * scale;
+        int i0 = (int)floor(x0), i1 = (int)ceil(x1);
+        if (i1 > src_n) i1 = src_n;
+        if (i1 - i0 > ax->taps) i1 = i0 + ax->taps;
+        ax->first[d] = i0;
+        ax->count[d] = i1 - i0;
+        for (int i = i0; i < i1; i++) {
+            double lo = i > x0 ? i : x0, hi = i + 1 < x1 ? i + 1 : x1;
+            ax->weight[(size_t)d * ax->taps + (i - i0)] = (float)((hi - lo) / scale);
+        }
+    }
+    return 1;
+}
+
+static void resample_axis_free(ResampleAxis *ax) {
+    free(ax->first);
+    free(ax->count);
+    free(ax->weight);
+}
+
+typedef struct {
+    const SDL_Surface *src;
+    SDL_Surface       *dst;
+    float             *tmp;     // src->h rows of dst->w premultiplied RGBA
+    ResampleAxis       ax, ay;
+} ResampleJob;
+
+// Horizontal pass: source rows -> premultiplied float rows of the target width
+static void resample_band_x(void *ctx, int band, int nbands) {
+    ResampleJob *j = (ResampleJob*)ctx;
+    int h = j->src->h, w = j->dst->w;
+    for (int y = h * band / nbands, y1 = h * (band + 1) / nbands; y < y1; y++) {
+        const Uint8 *row = (const Uint8*)j->src->pixels + (size_t)y * j->src->pitch;
+        float *out = j->tmp + (size_t)y * w * 4;
+        for (int x = 0; x < w; x++) {
+            const float *wt = j->ax.weight + (size_t)x * j->ax.taps;
+            const Uint8 *p  = row + 4 * j->ax.first[x];
+            float r = 0, g = 0, b = 0, a = 0;
+            for (int k = 0; k < j->ax.count[x]; k++, p += 4) {
+                float wa = wt[k] * p[3];
+                r += wa * p[0]; g += wa * p[1]; b += wa * p[2]; a += wa;
+            }
+            out[4*x+0] = r; out[4*x+1] = g; out[4*x+2] = b; out[4*x+3] = a;
+        }
+    }
+}
+
+// Vertical pass: premultiplied rows -> straight-alpha RGBA32
+static void resample_band_y(void *ctx, int band, int nbands) {
+    ResampleJob *j = (ResampleJob*)ctx;
+    int h = j->dst->h, w = j->dst->w;
+    for (int y = h * band / nbands, y1 = h * (band + 1) / nbands; y < y1; y++) {
+        const float *wt = j->ay.weight + (size_t)y * j->ay.taps;
+        Uint8 *out = (Uint8*)j->dst->pixels + (size_t)y * j->dst->pitch;
+        for (int x = 0; x < w; x++) {
+            const float *p = j->tmp + ((size_t)j->ay.first[y] * w + x) * 4;
+            float r = 0, g = 0, b = 0, a = 0;
+            for (int k = 0; k < j->ay.count[y]; k++, p += (size_t)w * 4) {
+                r += wt[k] * p[0]; g += wt[k] * p[1]; b += wt[k] * p[2]; a += wt[k] * p[3];
+            }
+            if (a > 0.0f) {
+                out[4*x+0] = clamp_u8((int)(r / a + .5f));
+                out[4*x+1] = clamp_u8((int)(g / a + .5f));
+                out[4*x+2] = clamp_u8((int)(b / a + .5f));
+            } else {
+                out[4*x+0] = out[4*x+1] = out[4*x+2] = 0;
+            }
+            out[4*x+3] = clamp_u8((int)(a + .5f));
+        }
+    }
+}
+
+// Resample an RGBA32 surface to w x h; returns a new surface or NULL
+static SDL_Surface* resample_surface(SDL_Surface *src, int w, int h) {
+    if (!src || w <= 0 || h <= 0) return NULL;
+    SDL_Surface *dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!dst) return NULL;
+
+    ResampleJob j;
+    SDL_zero(j);
+    j.src = src;
+    j.dst = dst;
+    j.tmp = (float*)malloc(sizeof(float) * 4 * (size_t)w * src->h);
+    if (!j.tmp || !resample_axis_init(&j.ax, src->w, w) || !resample_axis_init(&j.ay, src->h, h)) {
+        SDL_FreeSurface(dst);
+        dst = NULL;
+    } else {
+        if (SDL_MUSTLOCK(src)) SDL_LockSurface(src);
+        pool_parallel_for(resample_band_x, &j, (src->h + 63) / 64);
+        pool_parallel_for(resample_band_y, &j, (h + 15) / 16);
+        if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+    }
+    free(j.tmp);
+    resample_axis_free(&j.ax);
+    resample_axis_free(&j.ay);
+    return dst;
+}
+
+// ---------------------------------------------------------------------------
+// Sprite atlas
+//
+// All game sprites packed into one texture with a sub-rect per sprite, so
+// consecutive draws share a texture and the renderer can batch them.
+// Sprites are placed on shelves, tallest first, with a transparent gutter
+// so linear filtering never picks up a neighbour.
+//
+// Most of a processed sprite is the cleared backdrop, so each one is
+// trimmed to the bounds of its pixels that are not fully transparent
+// before packing. The atlas keeps where those bounds sit in the whole
+// sprite: it draws in the same place, but only the part that shows is
+// blended.
+// ---------------------------------------------------------------------------
+
+#define ATLAS_MIN_W  1024
+#define ATLAS_GUTTER 2
+#define ATLAS_WHITE  4      // side of the solid white block used for fills
+
+typedef struct {
+    SDL_Texture *tex;
+    int          w, h;
+    SDL_Rect     rect[SPR_COUNT];   // trimmed pixels in the page
+    SDL_Rect     trim[SPR_COUNT];   // the same within the whole sprite
+    SDL_Point    size[SPR_COUNT];   // whole sprite; zero for sprites that failed to load
+    SDL_Rect     white;             // opaque white, for untextured quads
+} SpriteAtlas;
+
+// Bounds of the pixels of RGBA32 surface `s` that are not fully
+// transparent; zero-sized if there are none
+static SDL_Rect sprite_opaque_bounds(const SDL_Surface *s) {
+    int x0 = s->w, y0 = -1, x1 = 0, y1 = 0;        // x1, y1 exclusive
+    for (int y = 0; y < s->h; y++) {
+        const Uint8 *row = (const Uint8*)s->pixels + (size_t)y * s->pitch;
+        int l = 0, r = s->w;
+        while (l < r && !row[4 * l + 3]) l++;
+        if (l == r) continue;
+        while (!row[4 * (r - 1) + 3]) r--;
+        if (y0 < 0) y0 = y;
+        y1 = y + 1;
+        if (l < x0) x0 = l;
+        if (r > x1) x1 = r;
+    }
+    if (y0 < 0) return (SDL_Rect){ 0, 0, 0, 0 };
+    return (SDL_Rect){ x0, y0, x1 - x0, y1 - y0 };
+}
+
+// Trim the given sprites, pack them and a small white block into one
+// RGBA32 page and fill in the atlas rects; returns the page, to be handed
+// to atlas_upload() on the render thread
+static SDL_Surface* atlas_pack(SDL_Surface *const spr[SPR_COUNT], SpriteAtlas *at) {
+    SDL_zerop(at);
+    int order[SPR_COUNT + 1], w[SPR_COUNT + 1], h[SPR_COUNT + 1], n = 0, aw = ATLAS_MIN_W;
+    SDL_Rect rect[SPR_COUNT + 1];
+    for (int i = 0; i < SPR_COUNT; i++) {
+        if (!spr[i]) continue;
+        order[n++] = i;
+        at->trim[i] = sprite_opaque_bounds(spr[i]);
+        at->size[i] = (SDL_Point){ spr[i]->w, spr[i]->h };
+        w[i] = at->trim[i].w;
+        h[i] = at->trim[i].h;
+        while (aw < w[i] + 2 * ATLAS_GUTTER) aw *= 2;
+    }
+    order[n++] = SPR_COUNT;                 // the white block
+    w[SPR_COUNT] = h[SPR_COUNT] = ATLAS_WHITE;
+    for (int i = 1; i < n; i++)             // insertion sort by height, tallest first
+        for (int k = i; k > 0 && h[order[k]] > h[order[k-1]]; k--) {
+            int t = order[k]; order[k] = order[k-1]; order[k-1] = t;
+        }
+
+    int x = ATLAS_GUTTER, y = ATLAS_GUTTER, shelf = 0;
+    for (int k = 0; k < n; k++) {
+        int i = order[k];
+        if (x + w[i] + ATLAS_GUTTER > aw) {
+            x = ATLAS_GUTTER;
+            y += shelf + ATLAS_GUTTER;
+            shelf = 0;
+        }
+        rect[i] = (SDL_Rect){ x, y, w[i], h[i] };
+        x += w[i] + ATLAS_GUTTER;
+        if (h[i] > shelf) shelf = h[i];
+    }
+    for (int k = 0; k < n; k++)
+        if (order[k] < SPR_COUNT) at->rect[order[k]] = rect[order[k]];
+    at->white = rect[SPR_COUNT];
+    at->w = aw;
+    at->h = y + shelf + ATLAS_GUTTER;
+
+    SDL_Surface *page = SDL_CreateRGBSurfaceWithFormat(0, at->w, at->h, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!page) return NULL;
+    SDL_FillRect(page, NULL, 0);
+    SDL_FillRect(page, &at->white, 0xffffffffu);
+    for (int k = 0; k < n; k++) {
+        if (order[k] == SPR_COUNT) continue;
+        SDL_Surface *s = spr[order[k]];
+        const SDL_Rect *r = &at->rect[order[k]], *t = &at->trim[order[k]];
+        for (int row = 0; row < r->h; row++)
+            memcpy((Uint8*)page->pixels + (size_t)(r->y + row) * page->pitch + 4 * r->x,
+                   (const Uint8*)s->pixels + (size_t)(t->y + row) * s->pitch + 4 * t->x,
+                   4 * (size_t)r->w);
+    }
+    return page;
+}
+
+// Create the atlas texture from a packed page; returns 0 on failure
+static int atlas_upload(SDL_Renderer *ren, SDL_Surface *page, SpriteAtlas *at) {
+    at->tex = page ? SDL_CreateTextureFromSurface(ren, page) : NULL;
+    if (!at->tex) {
+        fprintf(stderr, "SDL_CreateTexture(atlas): %s\n", SDL_GetError());
+        return 0;
+    }
+    SDL_SetTextureBlendMode(at->tex, SDL_BLENDMODE_BLEND);
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Software compositor
+//
+// Draws the sprite batch into an RGBA32 framebuffer in memory, for frames
+// rendered without a GPU (--render-png) and for comparing them between
+// builds. Every quad is taken from the atlas page and blended source-over
+// the way SDL_BLENDMODE_BLEND does, with its colour modulating the texels.
+// Each covered row is first fetched into a scratch row, by nearest or
+// bilinear sampling, then blended a vector of pixels at a time. Blending
+// uses exact integer arithmetic, so the scalar, SSE2 and AVX2 paths give
+// byte-identical frames.
+// ---------------------------------------------------------------------------
+
+enum { SOFT_NEAREST, SOFT_BILINEAR };
+
+typedef struct {
+    Uint32            *px;          // RGBA32, w * h, rows packed
+    int                w, h;
+    Uint32            *row;         // fetched texels of one row
+    const SDL_Surface *page;        // atlas pixels, RGBA32
+    int                filter;      // SOFT_*
+    int                isa;         // ISA_* path of the blend
+} SoftTarget;
+
+// Exact x / 255, rounded, for 0 <= x <= 65535
+static inline int soft_div255(int x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Texel `s` modulated by `mod`, blended over `d`. A texel with zero alpha
+// leaves `d` as it was, so the vector paths can skip runs of them.
+static inline void soft_blend_pixel(Uint8 *d, const Uint8 *s, const Uint8 *mod) {
+    int r = soft_div255(s[0] * mod[0]), g = soft_div255(s[1] * mod[1]);
+    int b = soft_div255(s[2] * mod[2]), a = soft_div255(s[3] * mod[3]);
+    d[0] = (Uint8)soft_div255(r * a + d[0] * (255 - a));
+    d[1] = (Uint8)soft_div255(g * a + d[1] * (255 - a));
+    d[2] = (Uint8)soft_div255(b * a + d[2] * (255 - a));
+    d[3] = (Uint8)soft_div255(255 * a + d[3] * (255 - a));
+}
+
+static void soft_blend_row_scalar(Uint32 *dst, const Uint32 *src, int n, Uint32 mod) {
+    for (int x = 0; x < n; x++)
+        soft_blend_pixel((Uint8*)(dst + x), (const Uint8*)(src + x), (const Uint8*)&mod);
+}
+
+#ifdef ISA_HAVE_X86
+// Same arithmetic on 16-bit lanes, two pixels per 128 bits
+__attribute__((target("sse2")))
+static inline __m128i soft_div255_sse2(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i soft_blend_half_sse2(__m128i s, __m128i d, __m128i mod, __m128i amask) {
+    s = soft_div255_sse2(_mm_mullo_epi16(s, mod));
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+    s = _mm_or_si128(s, amask);                     // alpha lane blends 255 * a
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(s, a),
+                              _mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), a)));
+    return soft_div255_sse2(t);
+}
+
+__attribute__((target("sse2")))
+static void soft_blend_row_sse2(Uint32 *dst, const Uint32 *src, int n, Uint32 mod) {
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i m     = _mm_unpacklo_epi8(_mm_set1_epi32((int)mod), zero);
+    const __m128i amask = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    int x = 0;
+    for (; x + 4 <= n; x += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + x));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(s, 24), zero)) == 0xFFFF)
+            continue;                               // all clear
+        __m128i d  = _mm_loadu_si128((const __m128i*)(dst + x));
+        __m128i lo = soft_blend_half_sse2(_mm_unpacklo_epi8(s, zero),
+                                          _mm_unpacklo_epi8(d, zero), m, amask);
+        __m128i hi = soft_blend_half_sse2(_mm_unpackhi_epi8(s, zero),
+                                          _mm_unpackhi_epi8(d, zero), m, amask);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(lo, hi));
+    }
+    soft_blend_row_scalar(dst + x, src + x, n - x, mod);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i soft_div255_avx2(__m256i x) {
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i soft_blend_half_avx2(__m256i s, __m256i d, __m256i mod, __m256i amask) {
+    s = soft_div255_avx2(_mm256_mullo_epi16(s, mod));
+    __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xFF), 0xFF);
+    s = _mm256_or_si256(s, amask);
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(s, a),
+                                 _mm256_mullo_epi16(d, _mm256_sub_epi16(_mm256_set1_epi16(255), a)));
+    return soft_div255_avx2(t);
+}
+
+__attribute__((target("avx2")))
+static void soft_blend_row_avx2(Uint32 *dst, const Uint32 *src, int n, Uint32 mod) {
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i m     = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)mod), zero);
+    const __m256i amask = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0,
+                                           255, 0, 0, 0, 255, 0, 0, 0);
+    int x = 0;
+    for (; x + 8 <= n; x += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + x));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_srli_epi32(s, 24), zero)) == -1)
+            continue;
+        __m256i d  = _mm256_loadu_si256((const __m256i*)(dst + x));
+        __m256i lo = soft_blend_half_avx2(_mm256_unpacklo_epi8(s, zero),
+                                          _mm256_unpacklo_epi8(d, zero), m, amask);
+        __m256i hi = soft_blend_half_avx2(_mm256_unpackhi_epi8(s, zero),
+                                          _mm256_unpackhi_epi8(d, zero), m, amask);
+        _mm256_storeu_si256((__m256i*)(dst + x), _mm256_packus_epi16(lo, hi));
+    }
+    soft_blend_row_scalar(dst + x, src + x, n - x, mod);
+}
+#endif
+
+static void soft_blend_row(int isa, Uint32 *dst, const Uint32 *src, int n, Uint32 mod) {
+#ifdef ISA_HAVE_X86
+    if (isa == ISA_AVX2) { soft_blend_row_avx2(dst, src, n, mod); return; }
+    if (isa == ISA_SSE2) { soft_blend_row_sse2(dst, src, n, mod); return; }
+#endif
+    (void)isa;
+    soft_blend_row_scalar(dst, src, n, mod);
+}
+
+// Make a w x h framebuffer; returns 0 on allocation failure
+static int soft_init(SoftTarget *t, int w, int h, const SDL_Surface *page, int filter) {
+    SDL_zerop(t);
+    t->px  = (Uint32*)malloc(sizeof *t->px * (size_t)w * h);
+    t->row = (Uint32*)malloc(sizeof *t->row * (size_t)w);
+    if (!t->px || !t->row) {
+        free(t->px);
+        free(t->row);
+        SDL_zerop(t);
+        return 0;
+    }
+    t->w = w;
+    t->h = h;
+    t->page   = page;
+    t->filter = filter;
+    t->isa    = cpu_best_isa();
+    return 1;
+}
+
+static void soft_free(SoftTarget *t) {
+    free(t->px);
+    free(t->row);
+    SDL_zerop(t);
+}
+
+static void soft_clear(SoftTarget *t, SDL_Color c) {
+    Uint32 v;
+    Uint8 *p = (Uint8*)&v;
+    p[0] = c.r;  p[1] = c.g;  p[2] = c.b;  p[3] = c.a;
+    for (size_t i = 0, n = (size_t)t->w * t->h; i < n; i++) t->px[i] = v;
+}
+
+// Texel of the page, 0 (transparent) outside it
+static inline Uint32 soft_texel(const SDL_Surface *pg, int x, int y) {
+    if ((unsigned)x >= (unsigned)pg->w || (unsigned)y >= (unsigned)pg->h) return 0;
+    return ((const Uint32*)((const Uint8*)pg->pixels + (size_t)y * pg->pitch))[x];
+}
+
+// a + (b - a) * f / 256 on all four bytes at once, for 0 <= f <= 256: red
+// and blue, then green and alpha, each scaled in 16-bit fields of one word
+static inline Uint32 soft_lerp(Uint32 a, Uint32 b, int f) {
+    Uint32 rb = ((a & 0x00FF00FF) * (Uint32)(256 - f) + (b & 0x00FF00FF) * (Uint32)f) >> 8;
+    Uint32 ga = (a >> 8 & 0x00FF00FF) * (Uint32)(256 - f) + (b >> 8 & 0x00FF00FF) * (Uint32)f;
+    return (rb & 0x00FF00FF) | (ga & 0xFF00FF00);
+}
+
+// Blend of four texels with 8-bit weights fx, fy
+static inline Uint32 soft_bilerp(Uint32 a, Uint32 b, Uint32 c, Uint32 d, int fx, int fy) {
+    return soft_lerp(soft_lerp(a, b, fx), soft_lerp(c, d, fx), fy);
+}
+
+// Draw one textured rectangle: screen corners, normalised texture corners
+// and modulation colour, as queued in the sprite batch. Pixels whose
+// centres fall inside the rectangle are drawn.
+static void soft_draw_quad(SoftTarget *t, float x0, float y0, float x1, float y1,
+                           float u0, float v0, float u1, float v1, SDL_Color color) {
+    const SDL_Surface *pg = t->page;
+    int xs = (int)ceilf(x0 - .5f), xe = (int)ceilf(x1 - .5f);
+    int ys = (int)ceilf(y0 - .5f), ye = (int)ceilf(y1 - .5f);
+    if (xs < 0) xs = 0;
+    if (ys < 0) ys = 0;
+    if (xe > t->w) xe = t->w;
+    if (ye > t->h) ye = t->h;
+    if (xs >= xe || ys >= ye || !pg || color.a == 0) return;
+
+    // Texel coordinates at the first pixel centre, and steps per pixel
+    float du = (u1 - u0) * pg->w / (x1 - x0), dv = (v1 - v0) * pg->h / (y1 - y0);
+    float tu = u0 * pg->w + (xs + .5f - x0) * du;
+    float tv = v0 * pg->h + (ys + .5f - y0) * dv;
+    Uint32 mod;
+    Uint8 *m = (Uint8*)&mod;
+    m[0] = color.r;  m[1] = color.g;  m[2] = color.b;  m[3] = color.a;
+    int n = xe - xs;
+
+    if (du == 0.f && dv == 0.f) {
+        // Solid fill from a single texel
+        Uint32 texel = soft_texel(pg, (int)tu, (int)tv);
+        for (int x = 0; x < n; x++) t->row[x] = texel;
+        for (int y = ys; y < ye; y++)
+            soft_blend_row(t->isa, t->px + (size_t)y * t->w + xs, t->row, n, mod);
+        return;
+    }
+    for (int y = ys; y < ye; y++, tv += dv) {
+        if (t->filter == SOFT_BILINEAR) {
+            float fv = tv - .5f;
+            int   ty = (int)floorf(fv), fy = (int)((fv - ty) * 256.f);
+            float u  = tu - .5f;
+            for (int x = 0; x < n; x++, u += du) {
+                int tx = (int)floorf(u), fx = (int)((u - tx) * 256.f);
+                t->row[x] = soft_bilerp(soft_texel(pg, tx, ty),     soft_texel(pg, tx + 1, ty),
+                                        soft_texel(pg, tx, ty + 1), soft_texel(pg, tx + 1, ty + 1),
+                                        fx, fy);
+            }
+        } else {
+            int ty = (int)floorf(tv), tx = (int)floorf(tu);
+            if (du == 1.f && tx >= 0 && tx + n <= pg->w && (unsigned)ty < (unsigned)pg->h) {
+                // Unscaled: blend straight from the page row
+                const Uint32 *src = (const Uint32*)((const Uint8*)pg->pixels +
+                                                    (size_t)ty * pg->pitch) + tx;
+                soft_blend_row(t->isa, t->px + (size_t)y * t->w + xs, src, n, mod);
+                continue;
+            }
+            float u = tu;
+            for (int x = 0; x < n; x++, u += du)
+                t->row[x] = soft_texel(pg, (int)floorf(u), ty);
+        }
+        soft_blend_row(t->isa, t->px + (size_t)y * t->w + xs, t->row, n, mod);
+    }
+}
+
+// Write the framebuffer as a PNG; returns 0 on failure
+static int soft_save_png(const SoftTarget *t, const char *path) {
+    SDL_Surface *s = SDL_CreateRGBSurfaceWithFormatFrom(t->px, t->w, t->h, 32, 4 * t->w,
+                                                        SDL_PIXELFORMAT_RGBA32);
+    int ok = s && IMG_SavePNG(s, path) == 0;
+    if (!ok) fprintf(stderr, "IMG_SavePNG('%s'): %s\n", path, IMG_GetError());
+    if (s) SDL_FreeSurface(s);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Sprite batch
+//
+// Every quad of a frame is queued with its texture and layer, and
+// sprite_batch_flush() submits them: a counting sort buckets the quads by
+// layer, then texture, keeping queue order within a bucket, and each run
+// that shares a texture goes out in one SDL_RenderGeometry() call. With
+// every sprite in the atlas and solid fills drawn from its white block, a
+// frame is a single call. Buffers only grow, so steady frames allocate
+// nothing. With a software target set, the same runs are composited into
+// it instead.
+// ---------------------------------------------------------------------------
+
+// Layers, drawn back to front
+enum { LAYER_WORLD, LAYER_PARTICLES, LAYER_SHOTS, LAYER_OVERLAY, LAYER_HUD, BATCH_LAYERS };
+
+#define BATCH_TEXTURES 8    // distinct textures per flush
+#define BATCH_BUCKETS  (BATCH_LAYERS * BATCH_TEXTURES)
+
+typedef struct {
+    float     x0, y0, x1, y1;       // screen corners
+    float     u0, v0, u1, v1;       // texture corners, normalised
+    SDL_Color color;
+    int       bucket;               // layer * BATCH_TEXTURES + texture slot
+} BatchQuad;
+
+typedef struct {
+    SDL_Renderer *ren;              // NULL: build vertices but submit nothing
+    SoftTarget   *soft;             // set: composite into this instead
+    SDL_Texture  *tex[BATCH_TEXTURES];
+    int           ntex;
+    BatchQuad    *quad;
+    int           n, cap;
+    SDL_Vertex   *vert;             // 4 per quad, in submission order
+    int          *index;            // 6 per quad, the same pattern for every call
+    int          *order;            // sort scratch
+    int           vert_cap;         // quads the three arrays above hold
+
+    // What was sent since sprite_batch_begin(); areas in game pixels,
+    // before clipping
+    int           draw_calls, vertices, quads;
+    double        pixels;           // blended
+    double        trimmed;          // left out by trimming sprites
+} SpriteBatch;
+
+static void sprite_batch_begin(SpriteBatch *b, SDL_Renderer *ren) {
+    b->ren  = ren;
+    b->ntex = 0;
+    b->n    = 0;
+    b->draw_calls = b->vertices = b->quads = 0;
+    b->pixels = b->trimmed = 0.0;
+}
+
+static void sprite_batch_flush(SpriteBatch *b);
+
+// Queue a quad from `tex`, with texture coordinates already normalised
+static void sprite_batch_quad(SpriteBatch *b, SDL_Texture *tex, int layer,
+                              float u0, float v0, float u1, float v1,
+                              const SDL_FRect *dst, SDL_Color color) {
+    int slot = 0;
+    while (slot < b->ntex && b->tex[slot] != tex) slot++;
+    if (slot == BATCH_TEXTURES) {
+        // Out of slots: send what is queued and start over
+        sprite_batch_flush(b);
+        slot = 0;
+    }
+    if (slot == b->ntex) b->tex[b->ntex++] = tex;
+    if (b->n == b->cap) {
+        int cap = b->cap ? 2 * b->cap : 256;
+        BatchQuad *q = (BatchQuad*)realloc(b->quad, sizeof *q * cap);
+        if (!q) return;
+        b->quad = q;
+        b->cap  = cap;
+    }
+    BatchQuad *q = &b->quad[b->n++];
+    q->x0 = dst->x;           q->y0 = dst->y;
+    q->x1 = dst->x + dst->w;  q->y1 = dst->y + dst->h;
+    q->u0 = u0;  q->v0 = v0;  q->u1 = u1;  q->v1 = v1;
+    q->color  = color;
+    q->bucket = layer * BATCH_TEXTURES + slot;
+    b->pixels += (double)dst->w * dst->h;
+}
+
+// Queue an atlas sprite
+static void sprite_batch_sprite(SpriteBatch *b, const SpriteAtlas *at, int layer,
+                                const SDL_Rect *src, const SDL_FRect *dst) {
+    const SDL_Color white = { 255, 255, 255, 255 };
+    float sx = 1.f / at->w, sy = 1.f / at->h;
+    sprite_batch_quad(b, at->tex, layer, src->x * sx, src->y * sy,
+                      (src->x + src->w) * sx, (src->y + src->h) * sy, dst, white);
+}
+
+// Queue atlas sprite `spr` over `dst`, the whole sprite's rectangle; only
+// its trimmed part goes out, where it sits in the sprite
+static void sprite_batch_trimmed(SpriteBatch *b, const SpriteAtlas *at, int layer, int spr,
+                                 const SDL_FRect *dst) {
+    const SDL_Rect *t = &at->trim[spr];
+    if (t->w <= 0 || t->h <= 0) {
+        b->trimmed += (double)dst->w * dst->h;
+        return;
+    }
+    float sx = dst->w / at->size[spr].x, sy = dst->h / at->size[spr].y;
+    SDL_FRect d = { dst->x + t->x * sx, dst->y + t->y * sy, t->w * sx, t->h * sy };
+    b->trimmed += (double)dst->w * dst->h - (double)d.w * d.h;
+    sprite_batch_sprite(b, at, layer, &at->rect[spr], &d);
+}
+
+// Queue a solid rectangle, drawn from the middle of the atlas white block
+static void sprite_batch_fill(SpriteBatch *b, const SpriteAtlas *at, int layer,
+                              const SDL_FRect *dst, SDL_Color color) {
+    float u = (at->white.x + at->white.w * .5f) / at->w;
+    float v = (at->white.y + at->white.h * .5f) / at->h;
+    sprite_batch_quad(b, at->tex, layer, u, v, u, v, dst, color);
+}
+
+// Make room for `n` quads of vertices, indices and sort order
+static int sprite_batch_reserve(SpriteBatch *b, int n) {
+    if (n <= b->vert_cap) return 1;
+    SDL_Vertex *vert  = (SDL_Vertex*)realloc(b->vert, sizeof *vert * 4 * n);
+    if (vert) b->vert = vert;
+    int *index = (int*)realloc(b->index, sizeof *index * 6 * n);
+    if (index) b->index = index;
+    int *order = (int*)realloc(b->order, sizeof *order * n);
+    if (order) b->order = order;
+    if (!vert || !index || !order) return 0;
+    for (int k = b->vert_cap; k < n; k++) {
+        int *ix = &b->index[6 * k], v = 4 * k;
+        ix[0] = v;      ix[1] = v + 1;  ix[2] = v + 2;
+        ix[3] = v + 2;  ix[4] = v + 1;  ix[5] = v + 3;
+    }
+    b->vert_cap = n;
+    return 1;
+}
+
+// Sort the queued quads, build their vertices and submit one call per run
+// of quads sharing a texture
+static void sprite_batch_flush(SpriteBatch *b) {
+    if (b->n == 0 || !sprite_batch_reserve(b, b->n)) {
+        b->n = b->ntex = 0;
+        return;
+    }
+
+    int start[BATCH_BUCKETS + 1] = { 0 };
+    for (int k = 0; k < b->n; k++) start[b->quad[k].bucket + 1]++;
+    for (int c = 0; c < BATCH_BUCKETS; c++) start[c + 1] += start[c];
+    for (int k = 0; k < b->n; k++) b->order[start[b->quad[k].bucket]++] = k;
+
+    for (int k = 0; k < b->n; k++) {
+        const BatchQuad *q = &b->quad[b->order[k]];
+        SDL_Vertex *v = &b->vert[4 * k];
+        v[0] = (SDL_Vertex){ { q->x0, q->y0 }, q->color, { q->u0, q->v0 } };
+        v[1] = (SDL_Vertex){ { q->x1, q->y0 }, q->color, { q->u1, q->v0 } };
+        v[2] = (SDL_Vertex){ { q->x0, q->y1 }, q->color, { q->u0, q->v1 } };
+        v[3] = (SDL_Vertex){ { q->x1, q->y1 }, q->color, { q->u1, q->v1 } };
+    }
+
+    for (int k = 0; k < b->n; ) {
+        int slot = b->quad[b->order[k]].bucket % BATCH_TEXTURES, end = k + 1;
+        while (end < b->n && b->quad[b->order[end]].bucket % BATCH_TEXTURES == slot) end++;
+        if (b->soft) {
+            for (int j = k; j < end; j++) {
+                const BatchQuad *q = &b->quad[b->order[j]];
+                soft_draw_quad(b->soft, q->x0, q->y0, q->x1, q->y1,
+                               q->u0, q->v0, q->u1, q->v1, q->color);
+            }
+        } else if (b->ren) {
+            SDL_RenderGeometry(b->ren, b->tex[slot], &b->vert[4 * k], 4 * (end - k),
+                               b->index, 6 * (end - k));
+        }
+        b->draw_calls++;
+        k = end;
+    }
+    b->vertices += 4 * b->n;
+    b->quads    += b->n;
+    b->n = b->ntex = 0;
+}
+
+static void sprite_batch_free(SpriteBatch *b) {
+    free(b->quad);
+    free(b->vert);
+    free(b->index);
+    free(b->order);
+    SDL_zerop(b);
+}
+
+// ---------------------------------------------------------------------------
+// Collision masks
+//
+// One bit per pixel, set where a sprite is at least half opaque, built at
+// the size the sprite is drawn at in game coordinates (not the HiDPI
+// texture size). Rows are packed into 64-bit words, pixel x in bit x % 64
+// of word x / 64, so testing a span of a row is a shift and an AND.
+// ---------------------------------------------------------------------------
+
+#define MASK_ALPHA_MIN 128
+
+typedef struct {
+    int     w, h, words;            // words: 64-bit words per row
+    Uint64 *bits;                   // h rows, NULL if there is no mask
+} CollisionMask;
+
+// Build a w x h mask from an RGBA32 surface of any size, sampling the
+// nearest source pixel
+static int mask_build(const SDL_Surface *s, int w, int h, CollisionMask *m) {
+    SDL_zerop(m);
+    if (w <= 0 || h <= 0) return 0;
+    int words = (w + 63) / 64;
+    Uint64 *bits = (Uint64*)calloc((size_t)words * h, sizeof *bits);
+    if (!bits) return 0;
+    for (int y = 0; y < h; y++) {
+        const Uint8 *src = (const Uint8*)s->pixels + (size_t)(y * s->h / h) * s->pitch;
+        Uint64 *row = bits + (size_t)y * words;
+        for (int x = 0; x < w; x++)
+            if (src[(size_t)(x * s->w / w) * 4 + 3] >= MASK_ALPHA_MIN)
+                row[x >> 6] |= 1ull << (x & 63);
+    }
+    m->w = w;  m->h = h;  m->words = words;  m->bits = bits;
+    return 1;
+}
+
+static void mask_free(CollisionMask *m) {
+    free(m->bits);
+    SDL_zerop(m);
+}
+
+// Is any pixel set in [x0, x1) x [y0, y1), in mask coordinates? The part
+// of the rect outside the mask counts as empty.
+static int mask_hits_rect(const CollisionMask *m, int x0, int y0, int x1, int y1) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > m->w) x1 = m->w;
+    if (y1 > m->h) y1 = m->h;
+    if (x0 >= x1 || y0 >= y1) return 0;
+
+    // OR the masked words of every row together and test once at the end;
+    // a shell spans one or two words, so this beats exiting early
+    int w0 = x0 >> 6, w1 = (x1 - 1) >> 6;
+    Uint64 first = ~0ull << (x0 & 63), last = ~0ull >> (63 - ((x1 - 1) & 63));
+    const Uint64 *row = m->bits + (size_t)y0 * m->words;
+    Uint64 any = 0;
+    if (w0 == w1) {
+        first &= last;
+        for (int y = y0; y < y1; y++, row += m->words)
+            any |= row[w0] & first;
+    } else {
+        for (int y = y0; y < y1; y++, row += m->words) {
+            any |= (row[w0] & first) | (row[w1] & last);
+            for (int k = w0 + 1; k < w1; k++)
+                any |= row[k];
+        }
+    }
+    return any != 0;
+}
+
+// ---------------------------------------------------------------------------
+// Processed sprite cache
+//
+// One file holding every sprite after backdrop removal and resampling to its
+// on-screen size, so a normal launch maps it and uploads the pixels directly
+// instead of decoding PNGs and redoing make_sprite_from_bg. Each entry
+// records the hash of the PNG it was made from; an entry whose source
+// changed is reprocessed and the file is rewritten at the end of loading.
+//
+// Several instances on one host share the cache: pixels are read in place
+// from the read-only mapping, whose pages come from the page cache, which
+// holds one copy however many instances map the file. An exclusive lock on
+// aeroboo.cache.lock is held from opening the cache until it has been
+// rewritten, so when instances start together only the first decodes; the
+// others wait for it and then find every entry.
+//
+// Layout: SpriteCacheHeader, `count` SpriteCacheEntry records, then each
+// sprite's RGBA32 pixels (pitch w*4) at a 64-byte aligned offset.
+// ---------------------------------------------------------------------------
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SPRITE_CACHE_FILE    "aeroboo.cache"
+#define SPRITE_CACHE_MAGIC   "ABOOSPR"
+#define SPRITE_CACHE_VERSION 2
+#define SPRITE_CACHE_MAX     32
+#define SPRITE_NAME_LEN      32
+
+typedef struct {
+    char   magic[8];
+    Uint32 version;
+    Uint32 count;
+} SpriteCacheHeader;
+
+typedef struct {
+    char   name[SPRITE_NAME_LEN];
+    Uint64 src_hash;            // hash of the source PNG bytes
+    Uint64 offset;              // pixel data, from start of file
+    Uint32 w, h;
+    Uint32 low, high;           // DESBLEND thresholds the pixels were made with
+    Uint32 req_w, req_h;        // size asked for (req_h 0: keep source aspect)
+} SpriteCacheEntry;
+
+static struct {
+    Uint8  *map;
+    size_t  map_size;
+    int     lock;               // from cache_lock(), 0 if not held
+    int     dirty;              // sprites reprocessed; rewrite on close
+    int     n;
+    struct {
+        char         name[SPRITE_NAME_LEN];
+        Uint64       src_hash;
+        int          req_w, req_h;
+        SDL_Surface *surf;      // processed pixels, possibly inside the mapping
+    } item[SPRITE_CACHE_MAX];
+} sprite_cache;
+
+// FNV-1a over a whole buffer
+static Uint64 hash_bytes(const void *data, size_t n) {
+    const Uint8 *p = (const Uint8*)data;
+    Uint64 h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// Map a whole file read-only; NULL if it is missing or empty
+static void* map_readonly(const char *path, size_t *size) {
+    void *m = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) m = NULL;
+        *size = (size_t)st.st_size;
+    }
+    close(fd);
+    return m;
+}
+
+// Take the population lock for the cache file at `path` (path.lock), waiting
+// while another instance holds it. Returns the descriptor + 1, or 0 when the
+// lock file cannot be made (e.g. a read-only directory): loading then goes
+// ahead unlocked.
+static int cache_lock(const char *path) {
+    char name[256];
+    SDL_snprintf(name, sizeof(name), "%s.lock", path);
+    int fd = open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return 0;
+    while (flock(fd, LOCK_EX) != 0) {
+        if (errno == EINTR) continue;
+        close(fd);
+        return 0;
+    }
+    return fd + 1;
+}
+
+// Release a lock from cache_lock(); closing the descriptor drops it
+static void cache_unlock(int *lock) {
+    if (*lock) close(*lock - 1);
+    *lock = 0;
+}
+
+// Map an existing cache file; a missing or stale file leaves none mapped
+static void sprite_cache_map(const char *path) {
+    size_t size;
+    void *m = map_readonly(path, &size);
+    if (!m) return;
+    const SpriteCacheHeader *hd = (const SpriteCacheHeader*)m;
+    if (size >= sizeof(*hd) &&
+        memcmp(hd->magic, SPRITE_CACHE_MAGIC, sizeof(hd->magic)) == 0 &&
+        hd->version == SPRITE_CACHE_VERSION && hd->count <= SPRITE_CACHE_MAX &&
+        sizeof(*hd) + (size_t)hd->count * sizeof(SpriteCacheEntry) <= size) {
+        sprite_cache.map      = (Uint8*)m;
+        sprite_cache.map_size = size;
+    } else {
+        munmap(m, size);
+    }
+}
+
+// Start a load from the cache file, if any. Holds the population lock until
+// sprite_cache_close().
+static void sprite_cache_open(const char *path) {
+    SDL_zero(sprite_cache);
+    sprite_cache.lock = cache_lock(path);
+    sprite_cache_map(path);
+}
+
+// Wrap an entry's pixels in the mapping as a surface. The file is untrusted:
+// an empty sprite or pixels reaching past the end of the mapping give NULL.
+static SDL_Surface* sprite_cache_entry_surface(const SpriteCacheEntry *e) {
+    if (e->w == 0 || e->h == 0 || e->offset > sprite_cache.map_size) return NULL;
+    Uint64 avail = sprite_cache.map_size - e->offset;
+    if ((Uint64)e->w > avail / 4 / e->h) return NULL;
+    return SDL_CreateRGBSurfaceWithFormatFrom(sprite_cache.map + e->offset,
+                                              (int)e->w, (int)e->h, 32, (int)e->w * 4,
+                                              SDL_PIXELFORMAT_RGBA32);
+}
+
+// Look up a sprite made from exactly these source bytes, thresholds and size
+static SDL_Surface* sprite_cache_find(const char *name, Uint64 src_hash, int low, int high,
+                                      int req_w, int req_h) {
+    if (!sprite_cache.map) return NULL;
+    const SpriteCacheHeader *hd = (const SpriteCacheHeader*)sprite_cache.map;
+    const SpriteCacheEntry  *e  = (const SpriteCacheEntry*)(hd + 1);
+    for (Uint32 i = 0; i < hd->count; i++, e++) {
+        if (strncmp(e->name, name, SPRITE_NAME_LEN) != 0) continue;
+        if ((int)e->req_w != req_w || (int)e->req_h != req_h) continue;
+        if (e->src_hash != src_hash || (int)e->low != low || (int)e->high != high) return NULL;
+        return sprite_cache_entry_surface(e);
+    }
+    return NULL;
+}
+
+// Remember a loaded sprite so the file can be rewritten; takes the surface
+static void sprite_cache_keep(const char *name, Uint64 src_hash, int req_w, int req_h,
+                              SDL_Surface *surf, int fresh) {
+    if (sprite_cache.n == SPRITE_CACHE_MAX) {
+        SDL_FreeSurface(surf);
+        return;
+    }
+    int i = sprite_cache.n++;
+    SDL_strlcpy(sprite_cache.item[i].name, name, SPRITE_NAME_LEN);
+    sprite_cache.item[i].src_hash = src_hash;
+    sprite_cache.item[i].req_w    = req_w;
+    sprite_cache.item[i].req_h    = req_h;
+    sprite_cache.item[i].surf     = surf;
+    if (fresh) sprite_cache.dirty++;
+}
+
+// Write every kept sprite to path (via a temporary file and rename)
+static int sprite_cache_write(const char *path) {
+    char tmp[256];
+    SDL_snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "Warning: cannot write %s\n", tmp);
+        return 0;
+    }
+
+    SpriteCacheHeader hd;
+    SDL_zero(hd);
+    memcpy(hd.magic, SPRITE_CACHE_MAGIC, sizeof(hd.magic));
+    hd.version = SPRITE_CACHE_VERSION;
+    hd.count   = (Uint32)sprite_cache.n;
+
+    SpriteCacheEntry e[SPRITE_CACHE_MAX];
+    SDL_zeroa(e);
+    Uint64 off = sizeof(hd) + sizeof(SpriteCacheEntry) * (Uint64)sprite_cache.n;
+    for (int i = 0; i < sprite_cache.n; i++) {
+        SDL_Surface *s = sprite_cache.item[i].surf;
+        off = (off + 63) & ~(Uint64)63;
+        SDL_strlcpy(e[i].name, sprite_cache.item[i].name, SPRITE_NAME_LEN);
+        e[i].src_hash = sprite_cache.item[i].src_hash;
+        e[i].offset   = off;
+        e[i].w        = (Uint32)s->w;
+        e[i].h        = (Uint32)s->h;
+        e[i].low      = DESBLEND_LOW;
+        e[i].high     = DESBLEND_HIGH;
+        e[i].req_w    = (Uint32)sprite_cache.item[i].req_w;
+        e[i].req_h    = (Uint32)sprite_cache.item[i].req_h;
+        off += (Uint64)s->w * s->h * 4;
+    }
+
+    int ok = fwrite(&hd, sizeof(hd), 1, f) == 1 &&
+             fwrite(e, sizeof(SpriteCacheEntry), (size_t)sprite_cache.n, f) == (size_t)sprite_cache.n;
+    for (int i = 0; ok && i < sprite_cache.n; i++) {
+        SDL_Surface *s = sprite_cache.item[i].surf;
+        static const Uint8 pad[64];
+        long at = ftell(f);
+        ok = fwrite(pad, 1, (size_t)(e[i].offset - (Uint64)at), f) == (size_t)(e[i].offset - (Uint64)at);
+        for (int y = 0; ok && y < s->h; y++)
+            ok = fwrite((Uint8*)s->pixels + (size_t)y * s->pitch, 4, (size_t)s->w, f) == (size_t)s->w;
+    }
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "Warning: failed to write sprite cache %s\n", path);
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+// Keep the mapped entries this run did not replace, so instances drawing at
+// another scale (--hidpi, a HiDPI screen) sharing the file keep theirs
+static void sprite_cache_carry_over(void) {
+    if (!sprite_cache.map) return;
+    const SpriteCacheHeader *hd = (const SpriteCacheHeader*)sprite_cache.map;
+    const SpriteCacheEntry  *e  = (const SpriteCacheEntry*)(hd + 1);
+    int kept = sprite_cache.n;
+    for (Uint32 i = 0; i < hd->count; i++, e++) {
+        if ((int)e->low != DESBLEND_LOW || (int)e->high != DESBLEND_HIGH) continue;
+        int seen = 0;
+        for (int k = 0; k < kept && !seen; k++)
+            seen = strncmp(sprite_cache.item[k].name, e->name, SPRITE_NAME_LEN) == 0 &&
+                   sprite_cache.item[k].req_w == (int)e->req_w &&
+                   sprite_cache.item[k].req_h == (int)e->req_h;
+        if (seen) continue;
+        SDL_Surface *surf = sprite_cache_entry_surface(e);
+        if (surf) sprite_cache_keep(e->name, e->src_hash, (int)e->req_w, (int)e->req_h, surf, 0);
+    }
+}
+
+// Rewrite the file if anything was reprocessed, then drop all references
+// and let the next instance in
+static void sprite_cache_close(const char *path) {
+    if (sprite_cache.dirty) {
+        sprite_cache_carry_over();
+        sprite_cache_write(path);
+    }
+    for (int i = 0; i < sprite_cache.n; i++) SDL_FreeSurface(sprite_cache.item[i].surf);
+    if (sprite_cache.map) munmap(sprite_cache.map, sprite_cache.map_size);
+    cache_unlock(&sprite_cache.lock);
+    SDL_zero(sprite_cache);
+}
+
+// ---------------------------------------------------------------------------
+// Decoded audio cache
+//
+// Sound effects decoded (and resampled) to the device format once, then
+// mapped on later launches and played in place through Mix_QuickLoad_RAW,
+// so startup does no codec work. The mapping has to outlive the chunks
+// that point into it; audio_cache_release() runs after they are freed.
+// Like the sprite cache it is shared between instances, which play the same
+// page-cache pages in place, and populated under a lock (aeroboo.pcm.lock)
+// held until audio_cache_write().
+//
+// Layout: AudioCacheHeader, `count` AudioCacheEntry records, then each
+// effect's PCM at a 64-byte aligned offset. A cache made for a different
+// device rate, format or channel count is ignored as a whole.
+// ---------------------------------------------------------------------------
+
+#define AUDIO_CACHE_FILE    "aeroboo.pcm"
+#define AUDIO_CACHE_MAGIC   "ABOOPCM"
+#define AUDIO_CACHE_VERSION 1
+#define AUDIO_CACHE_MAX     8
+
+typedef struct {
+    char   magic[8];
+    Uint32 version;
+    Uint32 count;
+    Sint32 freq;                // device spec the PCM was converted to
+    Uint16 format;
+    Uint16 channels;
+} AudioCacheHeader;
+
+typedef struct {
+    char   name[SPRITE_NAME_LEN];
+    Uint64 src_hash;            // hash of the compressed source file
+    Uint64 offset;              // PCM data, from start of file
+    Uint64 bytes;
+} AudioCacheEntry;
+
+static struct {
+    Uint8     *map;
+    size_t     map_size;
+    int        lock;            // from cache_lock(), 0 if not held
+    int        dirty;           // effects decoded this run
+    int        n;
+    int        freq, channels;
+    Uint16     format;
+    struct {
+        char       name[SPRITE_NAME_LEN];
+        Uint64     src_hash;
+        Mix_Chunk *chunk;       // not owned; must stay alive until written
+    } item[AUDIO_CACHE_MAX];
+} audio_cache;
+
+// Map an existing cache if it matches the open audio device
+static void audio_cache_open(const char *path) {
+    SDL_zero(audio_cache);
+    if (!Mix_QuerySpec(&audio_cache.freq, &audio_cache.format, &audio_cache.channels)) return;
+    audio_cache.lock = cache_lock(path);
+    size_t size;
+    Uint8 *m = (Uint8*)map_readonly(path, &size);
+    if (!m) return;
+    const AudioCacheHeader *hd = (const AudioCacheHeader*)m;
+    if (size >= sizeof(*hd) &&
+        memcmp(hd->magic, AUDIO_CACHE_MAGIC, sizeof(hd->magic)) == 0 &&
+        hd->version == AUDIO_CACHE_VERSION && hd->count <= AUDIO_CACHE_MAX &&
+        sizeof(*hd) + (size_t)hd->count * sizeof(AudioCacheEntry) <= size &&
+        hd->freq == audio_cache.freq && hd->format == audio_cache.format &&
+        hd->channels == audio_cache.channels) {
+        audio_cache.map      = m;
+        audio_cache.map_size = size;
+    } else {
+        munmap(m, size);
+    }
+}
+
+// A chunk playing straight from the mapping, or NULL if not cached
+static Mix_Chunk* audio_cache_find(const char *name, Uint64 src_hash) {
+    if (!audio_cache.map) return NULL;
+    const AudioCacheHeader *hd = (const AudioCacheHeader*)audio_cache.map;
+    const AudioCacheEntry  *e  = (const AudioCacheEntry*)(hd + 1);
+    for (Uint32 i = 0; i < hd->count; i++, e++) {
+        if (strncmp(e->name, name, SPRITE_NAME_LEN) != 0) continue;
+        if (e->src_hash != src_hash || e->bytes > 0xFFFFFFFFu) return NULL;
+        // Untrusted file: compare without a sum that could wrap
+        if (e->offset > audio_cache.map_size || e->bytes > audio_cache.map_size - e->offset)
+            return NULL;
+        return Mix_QuickLoad_RAW(audio_cache.map + e->offset, (Uint32)e->bytes);
+    }
+    return NULL;
+}
+
+// Remember a loaded effect for audio_cache_write()
+static void audio_cache_keep(const char *name, Uint64 src_hash, Mix_Chunk *chunk, int fresh) {
+    if (audio_cache.n == AUDIO_CACHE_MAX) return;
+    int i = audio_cache.n++;
+    SDL_strlcpy(audio_cache.item[i].name, name, SPRITE_NAME_LEN);
+    audio_cache.item[i].src_hash = src_hash;
+    audio_cache.item[i].chunk    = chunk;
+    if (fresh) audio_cache.dirty++;
+}
+
+// Write every kept effect to path (via a temporary file and rename)
+static int audio_cache_write_file(const char *path) {
+    char tmp[256];
+    SDL_snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "Warning: cannot write %s\n", tmp);
+        return 0;
+    }
+
+    AudioCacheHeader hd;
+    SDL_zero(hd);
+    memcpy(hd.magic, AUDIO_CACHE_MAGIC, sizeof(hd.magic));
+    hd.version  = AUDIO_CACHE_VERSION;
+    hd.count    = (Uint32)audio_cache.n;
+    hd.freq     = audio_cache.freq;
+    hd.format   = audio_cache.format;
+    hd.channels = (Uint16)audio_cache.channels;
+
+    AudioCacheEntry e[AUDIO_CACHE_MAX];
+    SDL_zeroa(e);
+    Uint64 off = sizeof(hd) + sizeof(AudioCacheEntry) * (Uint64)audio_cache.n;
+    for (int i = 0; i < audio_cache.n; i++) {
+        off = (off + 63) & ~(Uint64)63;
+        SDL_strlcpy(e[i].name, audio_cache.item[i].name, SPRITE_NAME_LEN);
+        e[i].src_hash = audio_cache.item[i].src_hash;
+        e[i].offset   = off;
+        e[i].bytes    = audio_cache.item[i].chunk->alen;
+        off += e[i].bytes;
+    }
+
+    int ok = fwrite(&hd, sizeof(hd), 1, f) == 1 &&
+             fwrite(e, sizeof(AudioCacheEntry), (size_t)audio_cache.n, f) == (size_t)audio_cache.n;
+    for (int i = 0; ok && i < audio_cache.n; i++) {
+        static const Uint8 pad[64];
+        size_t gap = (size_t)(e[i].offset - (Uint64)ftell(f));
+        ok = fwrite(pad, 1, gap, f) == gap &&
+             fwrite(audio_cache.item[i].chunk->abuf, 1, (size_t)e[i].bytes, f) == (size_t)e[i].bytes;
+    }
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "Warning: failed to write audio cache %s\n", path);
+        remove(tmp);
+        return 0;
+    }
+    audio_cache.dirty = 0;
+    return 1;
+}
+
+// Rewrite the cache file if any effect was decoded this run, then let the
+// next instance in
+static int audio_cache_write(const char *path) {
+    int ok = audio_cache.dirty ? audio_cache_write_file(path) : 1;
+    cache_unlock(&audio_cache.lock);
+    return ok;
+}
+
+// Unmap the cache; every chunk made by audio_cache_find() must be freed
+static void audio_cache_release(void) {
+    if (audio_cache.map) munmap(audio_cache.map, audio_cache.map_size);
+    cache_unlock(&audio_cache.lock);
+    SDL_zero(audio_cache);
+}
+
+// ---------------------------------------------------------------------------
+// Low-latency sound effects
+//
+// With --low-latency the device runs with a small buffer and sound effects
+// bypass SDL_mixer's channels: the game thread pushes them into a single-
+// producer / single-consumer ring, and a post-mix hook on the audio thread
+// pops them into a fixed pool of voices and adds their decoded PCM on top
+// of whatever SDL_mixer mixed. Neither side takes a lock, so triggering an
+// effect never waits for the audio callback.
+//
+// The hook also measures, in either mode, when the first sample of a shot
+// reaches the mix after the click that fired it (which includes the cannon
+// animation, as the shot leaves on its last frame) and after the step that
+// raised the cue, and counts callbacks that came more than two buffers
+// after the last one, when the device has most likely run dry
+// (--audio-stats).
+// ---------------------------------------------------------------------------
+
+#define SFX_DEFAULT_FRAMES     2048
+#define SFX_LOW_LATENCY_FRAMES 256
+#define SFX_VOICES             8
+#define SFX_QUEUE              64       // power of two
+
+typedef struct {
+    const Mix_Chunk *chunk;             // NULL: latency marker only
+    Uint64           t_click;           // click that caused it, or 0
+    Uint64           t_cue;             // when it was queued
+} SfxTrigger;
+
+typedef struct {
+    const Sint16 *pcm;                  // interleaved device samples
+    Uint32        len, pos;             // in samples
+} SfxVoice;
+
+static struct {
+    int         voices_on, stats_on;
+    int         freq, channels;
+    SfxTrigger  queue[SFX_QUEUE];
+    SDL_atomic_t head, tail;            // written by game / audio thread
+    SfxVoice    voice[SFX_VOICES];      // audio thread only
+    // Measurements, audio thread only until sfx_shutdown()
+    Uint64      last_cb;
+    int         frames;                 // device buffer, from the callback
+    long        callbacks, late, clicks, dropped;
+    double      latency_sum, latency_max;   // click to mix, ms
+    double      cue_sum, cue_max;           // cue to mix, ms
+} sfx;
+
+// Queue an effect for the audio thread; 0 if the ring is full
+static int sfx_push(const Mix_Chunk *chunk, Uint64 t_click) {
+    int head = SDL_AtomicGet(&sfx.head);
+    if ((unsigned)head - (unsigned)SDL_AtomicGet(&sfx.tail) == SFX_QUEUE) return 0;
+    sfx.queue[head & (SFX_QUEUE - 1)] = (SfxTrigger){ chunk, t_click,
+                                                      SDL_GetPerformanceCounter() };
+    SDL_AtomicSet(&sfx.head, head + 1);
+    return 1;
+}
+
+// Start a voice, taking over the one nearest its end if all are busy
+static void sfx_start_voice(const Mix_Chunk *c) {
+    SfxVoice *v = &sfx.voice[0];
+    for (int i = 0; i < SFX_VOICES; i++) {
+        if (sfx.voice[i].pos >= sfx.voice[i].len) {
+            v = &sfx.voice[i];
+            break;
+        }
+        if (sfx.voice[i].len - sfx.voice[i].pos < v->len - v->pos) v = &sfx.voice[i];
+    }
+    v->pcm = (const Sint16*)c->abuf;
+    v->len = c->alen / sizeof(Sint16);
+    v->pos = 0;
+}
+
+static void sfx_postmix(void *udata, Uint8 *stream, int len) {
+    (void)udata;
+    Uint64 now  = SDL_GetPerformanceCounter();
+    double freq = (double)SDL_GetPerformanceFrequency();
+    int frames  = len / (int)sizeof(Sint16) / sfx.channels;
+    if (sfx.last_cb && (now - sfx.last_cb) / freq > 2.0 * frames / sfx.freq) sfx.late++;
+    sfx.last_cb = now;
+    sfx.frames  = frames;
+    sfx.callbacks++;
+
+    // Take everything queued since the last callback
+    int tail = SDL_AtomicGet(&sfx.tail), head = SDL_AtomicGet(&sfx.head);
+    for (; tail != head; tail++) {
+        const SfxTrigger *t = &sfx.queue[tail & (SFX_QUEUE - 1)];
+        if (t->chunk && sfx.voices_on) sfx_start_voice(t->chunk);
+        if (t->t_click) {
+            double ms = (now - t->t_click) * 1000.0 / freq;
+            sfx.latency_sum += ms;
+            if (ms > sfx.latency_max) sfx.latency_max = ms;
+            ms = (now - t->t_cue) * 1000.0 / freq;
+            sfx.cue_sum += ms;
+            if (ms > sfx.cue_max) sfx.cue_max = ms;
+            sfx.clicks++;
+        }
+    }
+    SDL_AtomicSet(&sfx.tail, tail);
+
+    // Add the voices at full volume, as SDL_mixer plays a fresh chunk
+    Sint16 *out = (Sint16*)stream;
+    Uint32 n = (Uint32)len / sizeof(Sint16);
+    for (int k = 0; k < SFX_VOICES; k++) {
+        SfxVoice *v = &sfx.voice[k];
+        if (v->pos >= v->len) continue;
+        Uint32 m = v->len - v->pos < n ? v->len - v->pos : n;
+        const Sint16 *src = v->pcm + v->pos;
+        for (Uint32 i = 0; i < m; i++) {
+            int s = out[i] + src[i];
+            out[i] = (Sint16)(s > 32767 ? 32767 : (s < -32768 ? -32768 : s));
+        }
+        v->pos += m;
+    }
+}
+
+// Hook into the open device: voices for --low-latency, measurements for
+// --audio-stats. Voices need 16-bit samples; with any other device format
+// effects stay on SDL_mixer's channels.
+static void sfx_open(int voices_on, int stats_on) {
+    Uint16 format;
+    SDL_zero(sfx);
+    if (!Mix_QuerySpec(&sfx.freq, &format, &sfx.channels)) return;
+    if (voices_on && format != AUDIO_S16SYS) {
+        fprintf(stderr, "Warning: audio format 0x%x, low-latency effects off\n", format);
+        voices_on = 0;
+    }
+    sfx.voices_on = voices_on;
+    sfx.stats_on  = stats_on;
+    if (voices_on || stats_on) Mix_SetPostMix(sfx_postmix, NULL);
+}
+
+// Play an effect; `t_click` is the click that fired it, if one did
+static void sfx_play(Mix_Chunk *chunk, Uint64 t_click) {
+    if (!chunk) return;
+    if (sfx.voices_on) {
+        if (!sfx_push(chunk, t_click)) sfx.dropped++;
+        return;
+    }
+    Mix_PlayChannel(-1, chunk, 0);
+    if (t_click && sfx.stats_on) sfx_push(NULL, t_click);
+}
+
+// Unhook from the device, which also waits out a running callback, so the
+// chunks can be freed; prints the measurements (--audio-stats)
+static void sfx_close(void) {
+    if (!sfx.voices_on && !sfx.stats_on) return;
+    Mix_SetPostMix(NULL, NULL);
+    if (!sfx.stats_on) return;
+    printf("audio: %s, %d-frame buffer (%.1f ms) at %d Hz\n",
+           sfx.voices_on ? "low-latency voices" : "SDL_mixer channels",
+           sfx.frames, sfx.freq ? sfx.frames * 1000.0 / sfx.freq : 0.0, sfx.freq);
+    if (sfx.clicks) {
+        printf("audio: click to mix %.1f ms average, %.1f ms worst over %ld shots, "
+               "cannon animation included\n",
+               sfx.latency_sum / sfx.clicks, sfx.latency_max, sfx.clicks);
+        printf("audio: cue to mix %.1f ms average, %.1f ms worst; "
+               "about %.1f ms more until heard\n",
+               sfx.cue_sum / sfx.clicks, sfx.cue_max,
+               sfx.freq ? sfx.frames * 1000.0 / sfx.freq : 0.0);
+    }
+    printf("audio: %ld callbacks, %ld underruns, %ld effects dropped\n",
+           sfx.callbacks, sfx.late, sfx.dropped);
+    fflush(stdout);
+}
+
+// Sample the average backdrop color from the four corners
+static void sample_corners_color(SDL_Surface* s,
+                                 Uint8 *or_, Uint8 *og, Uint8 *ob) {
+    if (!s || !or_ || !og || !ob) return;
+    if (SDL_MUSTLOCK(s)) SDL_LockSurface(s);
+
+    Uint32 *pix = (Uint32*)s->pixels;
+    int w = s->w, h = s->h;
+    long sr=0, sg=0, sb=0;
+    SDL_PixelFormat* fmt = s->format;
+    Uint8 r,g,b,a;
+
+    Uint32 corners[4] = {
+        pix[0],
+        pix[w-1],
+        pix[(h-1)*w + 0],
+        pix[(h-1)*w + (w-1)]
+    };
+    for(int i=0; i<4; i++){
+        SDL_GetRGBA(corners[i], fmt, &r, &g, &b, &a);
+        sr += r; sg += g; sb += b;
+    }
+
+    if (SDL_MUSTLOCK(s)) SDL_UnlockSurface(s);
+    *or_ = (Uint8)(sr/4);
+    *og  = (Uint8)(sg/4);
+    *ob  = (Uint8)(sb/4);
+                                 }
+
+                                 // Automatically generate sprite alpha channel by removing backdrop
+                                 static void make_sprite_from_bg(SDL_Surface* s, int low, int high) {
+                                     if (!s) return;
+                                     if (s->format->format != SDL_PIXELFORMAT_RGBA32) return;
+                                     if (SDL_MUSTLOCK(s)) SDL_LockSurface(s);
+
+                                     Uint8 bg_r, bg_g, bg_b;
+                                     sample_corners_color(s, &bg_r, &bg_g, &bg_b);
+
+                                     // Vectorised, banded kernel; the float loop only if its tables can't be allocated
+                                     if (!desblend_surface(s, bg_r, bg_g, bg_b, low, high, ISA_BEST, 1))
+                                         make_sprite_from_bg_ref(s, bg_r, bg_g, bg_b, low, high);
+
+                                     if (SDL_MUSTLOCK(s)) SDL_UnlockSurface(s);
+                                 }
+
+                                 // Load a sprite's processed RGBA32 pixels at req_w x req_h (req_h 0 keeps
+                                 // the source aspect), from the sprite cache when the source PNG is
+                                 // unchanged. The surface belongs to the cache until sprite_cache_close().
+                                 static SDL_Surface* load_sprite_pixels(const char* path, int req_w, int req_h) {
+                                     size_t size = 0;
+                                     void *png = SDL_LoadFile(path, &size);
+                                     if (!png) {
+                                         fprintf(stderr, "SDL_LoadFile('%s'): %s\n", path, SDL_GetError());
+                                         return NULL;
+                                     }
+                                     Uint64 src_hash = hash_bytes(png, size);
+
+                                     SDL_Surface* s32 = sprite_cache_find(path, src_hash, DESBLEND_LOW, DESBLEND_HIGH,
+                                                                          req_w, req_h);
+                                     if (s32) {
+                                         SDL_free(png);
+                                         sprite_cache_keep(path, src_hash, req_w, req_h, s32, 0);
+                                         return s32;
+                                     }
+
+                                     SDL_Surface* orig = IMG_Load_RW(SDL_RWFromConstMem(png, (int)size), 1);
+                                     SDL_free(png);
+                                     if (!orig) {
+                                         fprintf(stderr, "IMG_Load('%s'): %s\n", path, IMG_GetError());
+                                         return NULL;
+                                     }
+                                     s32 = convert_to_rgba32(orig);
+                                     SDL_FreeSurface(orig);
+                                     if (!s32) return NULL;
+
+                                     make_sprite_from_bg(s32, DESBLEND_LOW, DESBLEND_HIGH);
+
+                                     int w = req_w, h = req_h ? req_h : (int)((double)req_w * s32->h / s32->w + .5);
+                                     SDL_Surface* scaled = resample_surface(s32, w, h);
+                                     SDL_FreeSurface(s32);
+                                     if (!scaled) {
+                                         fprintf(stderr, "Resample('%s') to %dx%d failed\n", path, w, h);
+                                         return NULL;
+                                     }
+                                     sprite_cache_keep(path, src_hash, req_w, req_h, scaled, 1);
+                                     return scaled;
+                                 }
+
+                                 // Load every game sprite at `scale` times its on-screen size; sprites that
+                                 // fail to load are left NULL
+                                 static void load_sprites(int scale, SDL_Surface *spr[SPR_COUNT]) {
+                                     for (int i = 0; i < SPR_COUNT; i++) {
+                                         const SpriteDef *d = &SPRITES[i];
+                                         int req_w = d->draw_w * scale, req_h = 0;
+                                         if (d->like >= 0 && spr[d->like]) {
+                                             req_w = spr[d->like]->w;
+                                             req_h = spr[d->like]->h;
+                                         }
+                                         spr[i] = load_sprite_pixels(d->file, req_w, req_h);
+                                     }
+                                 }
+
+                                                                              // Check intersection of two floating-point rectangles
+                                                                              static int rects_intersectf(float ax, float ay, float aw, float ah,
+                                                                                                          float bx, float by, float bw, float bh) {
+                                                                                  if (ax + aw <= bx) return 0;
+                                                                                  if (bx + bw <= ax) return 0;
+                                                                                  if (ay + ah <= by) return 0;
+                                                                                  if (by + bh <= ay) return 0;
+                                                                                  return 1;
+                                                                                                          }
+
+                                                                                                          // Whether `e` means the window contents were lost or rescaled, so a screen
+                                                                                                          // that is only drawn when something changes has to be drawn again
+                                                                                                          static int event_needs_redraw(const SDL_Event *e) {
+                                                                                                              if (e->type == SDL_RENDER_TARGETS_RESET) return 1;
+                                                                                                              if (e->type != SDL_WINDOWEVENT) return 0;
+                                                                                                              switch (e->window.event) {
+                                                                                                              case SDL_WINDOWEVENT_SHOWN:
+                                                                                                              case SDL_WINDOWEVENT_EXPOSED:
+                                                                                                              case SDL_WINDOWEVENT_SIZE_CHANGED:
+                                                                                                              case SDL_WINDOWEVENT_RESTORED:
+                                                                                                                  return 1;
+                                                                                                              }
+                                                                                                              return 0;
+                                                                                                          }
+
+                                                                                                          // Display the splash screen in the game window for SPLASH_DURATION_MS
+                                                                                                          // while assets load in the background; returns 1 if the window was closed.
+                                                                                                          // The image is presented once, then again only when the window asks for
+                                                                                                          // it; in between the thread sleeps until an event or the end of the splash.
+                                                                                                          static int show_splash(SDL_Renderer *ren, SDL_Texture *st) {
+                                                                                                              if (!st) return 0;
+                                                                                                              Uint32 start = SDL_GetTicks();
+                                                                                                              int redraw = 1;
+                                                                                                              for (;;) {
+                                                                                                                  if (redraw) {
+                                                                                                                      SDL_RenderClear(ren);
+                                                                                                                      SDL_RenderCopy(ren, st, NULL, NULL);
+                                                                                                                      SDL_RenderPresent(ren);
+                                                                                                                      redraw = 0;
+                                                                                                                  }
+                                                                                                                  Uint32 elapsed = SDL_GetTicks() - start;
+                                                                                                                  if (elapsed >= SPLASH_DURATION_MS) return 0;
+                                                                                                                  SDL_Event e;
+                                                                                                                  if (!SDL_WaitEventTimeout(&e, (int)(SPLASH_DURATION_MS - elapsed))) continue;
+                                                                                                                  do {
+                                                                                                                      if (e.type == SDL_QUIT) return 1;
+                                                                                                                      redraw |= event_needs_redraw(&e);
+                                                                                                                  } while (SDL_PollEvent(&e));
+                                                                                                              }
+                                                                                                          }
+
+// ---------------------------------------------------------------------------
+// Game assets
+//
+// Everything the game loop draws and plays. Sprite pixels are uploaded into
+// the atlas and dropped; only sprites named in the keep mask also stay in
+// CPU memory, for features that need to read them back.
+//
+// Loading runs on a background thread started as soon as the window exists:
+// it decodes the entry mascot first, then the sound effects, then the
+// sprites (cache lookup or decode, backdrop removal, resampling, atlas
+// packing). Only the texture uploads are left for the render thread, in
+// assets_load_finish().
+// ---------------------------------------------------------------------------
+
+#include <sys/resource.h>
+
+enum { SFX_CANON, SFX_EXPLOSION, SFX_WINNER, SFX_COUNT };
+
+// Sound effects, each with a WAV fallback
+static const char *const SFX_FILES[SFX_COUNT][2] = {
+    [SFX_CANON]     = { "canon.mp3",     "canon.wav"     },
+    [SFX_EXPLOSION] = { "explosion.mp3", "explosion.wav" },
+    [SFX_WINNER]    = { "win.mp3",       "win.wav"       },
+};
+
+// Keep masks for assets_load(): bit (1 << SPR_*) per sprite
+#define SPRITE_KEEP_NONE 0u
+
+typedef struct {
+    SpriteAtlas  atlas;
+    SDL_Surface *pixels[SPR_COUNT];     // CPU copies of kept sprites only
+    Mix_Music   *music;                 // vulture theme, streamed by SDL_mixer
+    Mix_Chunk   *sfx[SFX_COUNT];
+    CollisionMask bird_mask[2];         // SPR_BU1 and SPR_BU2 at draw size
+} GameAssets;
+
+// A sound effect, read atomically: --hot-reload swaps them while the
+// simulation thread plays them
+static Mix_Chunk* assets_sfx(const GameAssets *as, int i) {
+    return (Mix_Chunk*)SDL_AtomicGetPtr((void**)&as->sfx[i]);
+}
+
+// Decode one sound effect, or play it from the audio cache when the source
+// file is unchanged
+static Mix_Chunk* load_sfx(const char *path, int use_cache) {
+    if (!use_cache) return Mix_LoadWAV(path);
+    size_t size = 0;
+    void *data = SDL_LoadFile(path, &size);
+    if (!data) return NULL;
+    Uint64 src_hash = hash_bytes(data, size);
+    Mix_Chunk *chunk = audio_cache_find(path, src_hash);
+    int fresh = !chunk;
+    if (fresh) chunk = Mix_LoadWAV_RW(SDL_RWFromConstMem(data, (int)size), 1);
+    SDL_free(data);
+    if (chunk) audio_cache_keep(path, src_hash, chunk, fresh);
+    return chunk;
+}
+
+typedef struct {
+    GameAssets   assets;            // everything but the atlas texture
+    SDL_Surface *page;              // packed atlas pixels awaiting upload
+    SDL_Surface *mascot;            // entry screen mascot (may be NULL)
+    int          scale;
+    Uint32       keep;
+    int          audio_cache;       // use the decoded audio cache
+    double       sfx_ms;            // time to get all sound effects ready
+    int          sfx_decoded;       // effects not found in the audio cache
+    int          sprites_made;      // sprites not found in the sprite cache
+    SDL_sem     *mascot_ready;
+    SDL_Thread  *thread;
+    int          pending;           // begun but not yet finished
+    Uint64       t_start, t_done;   // performance counter
+} AssetLoader;
+
+static int asset_loader_main(void *data) {
+    AssetLoader *ld = (AssetLoader*)data;
+    GameAssets  *as = &ld->assets;
+
+    // The entry screen needs the mascot soonest
+    ld->mascot = IMG_Load(ENTRY_IMG);
+    if (!ld->mascot) fprintf(stderr, "IMG_Load('%s'): %s\n", ENTRY_IMG, IMG_GetError());
+    SDL_SemPost(ld->mascot_ready);
+
+    // Music is streamed by SDL_mixer as it plays; sound effects are
+    // played from the audio cache, or decoded now and cached
+    as->music = Mix_LoadMUS("vulture.mp3");
+    if (!as->music) as->music = Mix_LoadMUS("vulture.wav");
+    Uint64 t_sfx = SDL_GetPerformanceCounter();
+    if (ld->audio_cache) audio_cache_open(AUDIO_CACHE_FILE);
+    for (int i = 0; i < SFX_COUNT; i++) {
+        as->sfx[i] = load_sfx(SFX_FILES[i][0], ld->audio_cache);
+        if (!as->sfx[i]) as->sfx[i] = load_sfx(SFX_FILES[i][1], ld->audio_cache);
+        if (!as->sfx[i])
+            fprintf(stderr, "Warning: failed to load %s/.wav: %s\n",
+                    SFX_FILES[i][0], Mix_GetError());
+    }
+    ld->sfx_decoded = ld->audio_cache ? audio_cache.dirty : SFX_COUNT;
+    if (ld->audio_cache) audio_cache_write(AUDIO_CACHE_FILE);
+    ld->sfx_ms = (SDL_GetPerformanceCounter() - t_sfx) * 1000.0 /
+                 (double)SDL_GetPerformanceFrequency();
+
+    // Sprites at their on-screen size, packed into one atlas texture; the
+    // processed pixels come from the cache file when it is up to date
+    SDL_Surface *spr[SPR_COUNT] = {0};
+    sprite_cache_open(SPRITE_CACHE_FILE);
+    load_sprites(ld->scale, spr);
+    ld->page = atlas_pack(spr, &as->atlas);
+    for (int f = 0; f < 2; f++) {
+        const SDL_Surface *b = spr[SPR_BU1 + f];
+        if (b) mask_build(b, BIRD_DRAW_W,
+                          (int)(b->h * ((float)BIRD_DRAW_W / (float)b->w) + .5f),
+                          &as->bird_mask[f]);
+    }
+    for (int i = 0; i < SPR_COUNT; i++)
+        if ((ld->keep & (1u << i)) && spr[i])
+            as->pixels[i] = SDL_ConvertSurfaceFormat(spr[i], SDL_PIXELFORMAT_RGBA32, 0);
+    ld->sprites_made = sprite_cache.dirty;
+    sprite_cache_close(SPRITE_CACHE_FILE);
+
+    ld->t_done = SDL_GetPerformanceCounter();
+    return 0;
+}
+
+// Start loading in the background; audio must already be open so sound
+// effects are decoded straight to the device format
+static void assets_load_begin(AssetLoader *ld, int scale, Uint32 keep, int audio_cache) {
+    SDL_zerop(ld);
+    ld->scale        = scale;
+    ld->keep         = keep;
+    ld->audio_cache  = audio_cache;
+    ld->pending      = 1;
+    ld->t_start      = SDL_GetPerformanceCounter();
+    ld->mascot_ready = SDL_CreateSemaphore(0);
+    ld->thread       = SDL_CreateThread(asset_loader_main, "aeroboo-load", ld);
+    if (!ld->thread) {
+        fprintf(stderr, "Warning: loading assets in the foreground: %s\n", SDL_GetError());
+        asset_loader_main(ld);
+    }
+}
+
+// Block until the entry mascot is decoded; the caller owns the surface
+static SDL_Surface* assets_load_mascot(AssetLoader *ld) {
+    if (ld->mascot_ready) SDL_SemWait(ld->mascot_ready);
+    SDL_Surface *s = ld->mascot;
+    ld->mascot = NULL;
+    return s;
+}
+
+// Wait for the loader, upload the atlas (skipped when ren is NULL, e.g. on
+// early exit) and hand everything over to `as`
+static void assets_load_finish(AssetLoader *ld, SDL_Renderer *ren, GameAssets *as) {
+    if (ld->thread) SDL_WaitThread(ld->thread, NULL);
+    ld->thread = NULL;
+    if (ren) atlas_upload(ren, ld->page, &ld->assets.atlas);
+    *as = ld->assets;
+    if (ld->page)         SDL_FreeSurface(ld->page);
+    if (ld->mascot)       SDL_FreeSurface(ld->mascot);
+    if (ld->mascot_ready) SDL_DestroySemaphore(ld->mascot_ready);
+    ld->page = ld->mascot = NULL;
+    ld->mascot_ready = NULL;
+    ld->pending = 0;
+}
+
+static void assets_free(GameAssets *as) {
+    if (as->music) Mix_FreeMusic(as->music);
+    for (int i = 0; i < SFX_COUNT; i++)
+        if (as->sfx[i]) Mix_FreeChunk(as->sfx[i]);
+    audio_cache_release();
+    if (as->atlas.tex) SDL_DestroyTexture(as->atlas.tex);
+    for (int i = 0; i < SPR_COUNT; i++)
+        if (as->pixels[i]) SDL_FreeSurface(as->pixels[i]);
+    for (int f = 0; f < 2; f++) mask_free(&as->bird_mask[f]);
+    SDL_zerop(as);
+}
+
+// Resident pages no other process maps (Private_*), and this process's
+// proportional share of the pages it does share (Pss); -1 without
+// /proc/self/smaps_rollup
+static void process_uss_pss_kib(long *uss, long *pss) {
+    *uss = *pss = -1;
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) return;
+    char line[128];
+    long v, clean = -1, dirty = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "Pss: %ld", &v) == 1)           *pss  = v;
+        if (sscanf(line, "Private_Clean: %ld", &v) == 1) clean = v;
+        if (sscanf(line, "Private_Dirty: %ld", &v) == 1) dirty = v;
+    }
+    fclose(f);
+    if (clean >= 0 && dirty >= 0) *uss = clean + dirty;
+}
+
+// Current and peak resident set size of the process
+static void process_rss_kib(long *cur, long *peak) {
+    struct rusage ru;
+    *peak = getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : -1;
+    *cur  = -1;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        long size, resident;
+        if (fscanf(f, "%ld %ld", &size, &resident) == 2)
+            *cur = resident * (sysconf(_SC_PAGESIZE) / 1024);
+        fclose(f);
+    }
+}
+
+// Print what every loaded asset costs, and the process RSS (--mem-report)
+static void mem_report(const char *when, const GameAssets *as) {
+    size_t total = 0;
+    printf("memory at %s:\n", when);
+    if (as->atlas.tex) {
+        Uint32 fmt = SDL_PIXELFORMAT_RGBA32;
+        SDL_QueryTexture(as->atlas.tex, &fmt, NULL, NULL, NULL);
+        size_t b = (size_t)as->atlas.w * as->atlas.h * SDL_BYTESPERPIXEL(fmt);
+        printf("  texture  %-16s %5dx%-5d %8zu KiB\n", "sprite atlas",
+               as->atlas.w, as->atlas.h, b / 1024);
+        total += b;
+    }
+    for (int i = 0; i < SPR_COUNT; i++) {
+        const SDL_Surface *s = as->pixels[i];
+        if (!s) continue;
+        size_t b = (size_t)s->pitch * s->h;
+        printf("  surface  %-16s %5dx%-5d %8zu KiB\n", SPRITES[i].file, s->w, s->h, b / 1024);
+        total += b;
+    }
+    for (int i = 0; i < SFX_COUNT; i++) {
+        if (!as->sfx[i]) continue;
+        printf("  chunk    %-16s %11s %8u KiB  %s\n", SFX_FILES[i][0], "",
+               as->sfx[i]->alen / 1024, as->sfx[i]->allocated ? "decoded" : "mapped");
+        total += as->sfx[i]->alen;
+    }
+    for (int f = 0; f < 2; f++) {
+        const CollisionMask *m = &as->bird_mask[f];
+        if (!m->bits) continue;
+        size_t b = sizeof m->bits[0] * m->words * m->h;
+        printf("  mask     %-16s %5dx%-5d %8zu KiB\n", SPRITES[SPR_BU1 + f].file, m->w, m->h,
+               b / 1024);
+        total += b;
+    }
+    if (as->music) printf("  music    %-16s %11s %12s\n", "vulture.mp3", "", "streamed");
+    printf("  assets total %33zu KiB\n", total / 1024);
+
+    long cur, peak;
+    process_rss_kib(&cur, &peak);
+    printf("  process RSS %ld KiB, peak %ld KiB\n", cur, peak);
+    long uss, pss;
+    process_uss_pss_kib(&uss, &pss);
+    if (uss >= 0)
+        printf("  unique to this instance %ld KiB, proportional share %ld KiB\n", uss, pss);
+    fflush(stdout);
+}
+
+// Print the CPU time all threads used since the marks `cpu0` and `t0`, as a
+// share of one core over that wall time, and move the marks (--cpu-usage)
+static void cpu_report(const char *what, double *cpu0, Uint64 *t0) {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return;
+    double cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+                 (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    Uint64 t = SDL_GetPerformanceCounter();
+    double wall = (double)(t - *t0) / (double)SDL_GetPerformanceFrequency();
+    if (wall > 0.0)
+        printf("cpu: %-8s %5.1f%% of a core over %.1f s\n", what,
+               100.0 * (cpu - *cpu0) / wall, wall);
+    fflush(stdout);
+    *cpu0 = cpu;
+    *t0   = t;
+}
+
+// Reprocess every sprite from its PNG at `scale` and rewrite the cache at
+// `path`, keeping its entries for other scales. The old file is only mapped
+// once loading is done, so nothing is taken from it for this scale.
+static int sprite_cache_bake(const char *path, int scale, int verbose) {
+    SDL_zero(sprite_cache);
+    sprite_cache.lock = cache_lock(path);
+    SDL_Surface *spr[SPR_COUNT] = {0};
+    load_sprites(scale, spr);
+    int failed = 0;
+    for (int i = 0; i < SPR_COUNT; i++) {
+        if (!spr[i]) {
+            failed = 1;
+            continue;
+        }
+        if (verbose) printf("baked %-14s %dx%d\n", SPRITES[i].file, spr[i]->w, spr[i]->h);
+    }
+    if (!failed) {
+        sprite_cache_map(path);
+        sprite_cache_carry_over();
+        if (!sprite_cache_write(path)) failed = 1;
+    }
+    sprite_cache.dirty = 0;
+    sprite_cache_close(path);
+    return failed;
+}
+
+// Reprocess every sprite and write the sprite cache (--bake)
+static int bake_sprites(int scale) {
+    IMG_Init(IMG_INIT_PNG);
+    int failed = sprite_cache_bake(SPRITE_CACHE_FILE, scale, 1);
+    pool_shutdown();
+    IMG_Quit();
+    return failed;
+}
+
+// ---------------------------------------------------------------------------
+// Frame profiler
+//
+// Scoped timers around each phase of the game loop, all behind one global
+// flag so they cost a predictable branch when profiling is off. When on,
+// the profiler keeps per-phase times for the HUD (F3), a histogram of
+// every frame time for --stats, and can stream each timed scope to a
+// Chrome / Perfetto trace file (--trace out.json).
+// ---------------------------------------------------------------------------
+
+enum { PROF_EVENTS, PROF_SIM, PROF_AUDIO, PROF_DRAW, PROF_SUBMIT, PROF_PRESENT,
+       PROF_PACE, PROF_PHASES };
+
+static const char *const PROF_NAMES[PROF_PHASES] = {
+    "events", "sim", "audio", "draw", "submit", "present", "pace",
+};
+
+#define PROF_RING       256     // recent frames kept for the HUD
+#define PROF_HIST_MS    100     // histogram range; longer frames go in the last bucket
+#define PROF_HIST_PER_MS  4
+#define PROF_HIST_STEP  (1.0 / PROF_HIST_PER_MS)
+#define PROF_HIST_SIZE  (PROF_HIST_MS * PROF_HIST_PER_MS)
+
+static struct {
+    int     on, hud;
+    double  tick_ms;                    // milliseconds per counter tick
+    Uint64  frame_start, origin;
+    Uint64  phase[PROF_PHASES];         // ticks in the current frame
+    float   ring[PROF_RING];            // recent frame times, ms
+    float   ring_phase[PROF_RING][PROF_PHASES];
+    int     ring_pos, ring_n;
+    long    hist[PROF_HIST_SIZE];
+    long    frames;
+    double  phase_total[PROF_PHASES];   // ms over the whole run
+    FILE   *trace;
+    int     trace_events;
+} prof;
+
+// Scoped timers: PROF_BEGIN(PROF_SIM); ... PROF_END(PROF_SIM); a scope
+// begun before the profiler was started (F3) records nothing
+#define PROF_BEGIN(ph) Uint64 prof_t_##ph = prof.on ? SDL_GetPerformanceCounter() : 0
+#define PROF_END(ph)   do { if (prof.on && prof_t_##ph) prof_record(ph, prof_t_##ph); } while (0)
+
+static void prof_trace_event(const char *name, int tid, Uint64 t0, Uint64 t1) {
+    fprintf(prof.trace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%.3f,\"dur\":%.3f}", prof.trace_events++ ? ",\n" : "", name, tid,
+            (double)(t0 - prof.origin) * prof.tick_ms * 1000.0,
+            (double)(t1 - t0) * prof.tick_ms * 1000.0);
+}
+
+// Start profiling; `trace_path` may be NULL. Returns 0 if the trace file
+// could not be created.
+static int prof_start(const char *trace_path) {
+    prof.on          = 1;
+    prof.tick_ms     = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    prof.origin      = SDL_GetPerformanceCounter();
+    prof.frame_start = prof.origin;
+    if (trace_path && !prof.trace) {
+        prof.trace = fopen(trace_path, "w");
+        if (!prof.trace) {
+            fprintf(stderr, "Warning: cannot write trace '%s'\n", trace_path);
+            return 0;
+        }
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", prof.trace);
+    }
+    return 1;
+}
+
+static void prof_record(int ph, Uint64 t0) {
+    Uint64 t1 = SDL_GetPerformanceCounter();
+    prof.phase[ph] += t1 - t0;
+    if (prof.trace) prof_trace_event(PROF_NAMES[ph], 1, t0, t1);
+}
+
+// Close the current frame: file its time and phases, start the next one
+static void prof_frame_end(void) {
+    if (!prof.on) return;
+    Uint64 now = SDL_GetPerformanceCounter();
+    float ms = (float)((now - prof.frame_start) * prof.tick_ms);
+    if (prof.trace) prof_trace_event("frame", 0, prof.frame_start, now);
+    prof.frame_start = now;
+
+    prof.ring[prof.ring_pos] = ms;
+    for (int p = 0; p < PROF_PHASES; p++) {
+        float pm = (float)(prof.phase[p] * prof.tick_ms);
+        prof.ring_phase[prof.ring_pos][p] = pm;
+        prof.phase_total[p] += pm;
+        prof.phase[p] = 0;
+    }
+    prof.ring_pos = (prof.ring_pos + 1) % PROF_RING;
+    if (prof.ring_n < PROF_RING) prof.ring_n++;
+
+    int b = (int)(ms / PROF_HIST_STEP);
+    prof.hist[b < PROF_HIST_SIZE ? b : PROF_HIST_SIZE - 1]++;
+    prof.frames++;
+}
+
+// Forget the current frame, for a loop that just slept instead of drawing
+static void prof_frame_drop(void) {
+    if (!prof.on) return;
+    prof.frame_start = SDL_GetPerformanceCounter();
+    SDL_memset(prof.phase, 0, sizeof prof.phase);
+}
+
+static int prof_cmp_float(const void *a, const void *b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+// p50 and p99 of the recent frames, in ms
+static void prof_recent_percentiles(float *p50, float *p99) {
+    float tmp[PROF_RING];
+    int n = prof.ring_n;
+    *p50 = *p99 = 0.f;
+    if (!n) return;
+    memcpy(tmp, prof.ring, sizeof tmp[0] * n);
+    qsort(tmp, n, sizeof tmp[0], prof_cmp_float);
+    *p50 = tmp[n / 2];
+    *p99 = tmp[(n * 99) / 100];
+}
+
+// Frame time (ms) below which fraction `q` of all frames fell
+static double prof_hist_percentile(double q) {
+    long want = (long)(q * prof.frames), seen = 0;
+    for (int b = 0; b < PROF_HIST_SIZE; b++) {
+        seen += prof.hist[b];
+        if (seen > want) return (b + 1) * PROF_HIST_STEP;
+    }
+    return PROF_HIST_SIZE * PROF_HIST_STEP;
+}
+
+// Frame-time histogram and phase averages for the whole run (--stats)
+static void prof_print_stats(void) {
+    if (!prof.frames) return;
+    printf("frames: %ld, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms (%.2f ms buckets)\n",
+           prof.frames, prof_hist_percentile(0.50), prof_hist_percentile(0.90),
+           prof_hist_percentile(0.99), PROF_HIST_STEP);
+
+    // One row per millisecond, with a bar scaled to the busiest row
+    long rows[PROF_HIST_MS] = { 0 }, most = 1;
+    int last = 0;
+    for (int b = 0; b < PROF_HIST_SIZE; b++)
+        rows[b / PROF_HIST_PER_MS] += prof.hist[b];
+    for (int r = 0; r < PROF_HIST_MS; r++) {
+        if (rows[r] > most) most = rows[r];
+        if (rows[r]) last = r;
+    }
+    for (int r = 0; r <= last; r++) {
+        char bar[41];
+        int len = (int)(rows[r] * 40 / most);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        printf("  %3d-%-3d ms %8ld %s\n", r, r + 1, rows[r], bar);
+    }
+    printf("phase averages:");
+    for (int p = 0; p < PROF_PHASES; p++)
+        printf(" %s %.3f", PROF_NAMES[p], prof.phase_total[p] / prof.frames);
+    printf(" ms\n");
+    fflush(stdout);
+}
+
+static void prof_stop(void) {
+    if (prof.trace) {
+        fputs("\n]}\n", prof.trace);
+        fclose(prof.trace);
+        prof.trace = NULL;
+    }
+    prof.on = 0;
+}
+
+// HUD text uses a 3x5 pixel font, one 15-bit row-major bitmap per glyph
+static Uint16 hud_glyph(char c) {
+    static const Uint16 digits[10] = {
+        075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, 075757, 075717,
+    };
+    if (c >= '0' && c <= '9') return digits[c - '0'];
+    switch (c) {
+    case '.': return 000002;
+    case 'p': return 075744;
+    case 'm': return 007755;
+    case 's': return 034716;
+    default:  return 0;
+    }
+}
+
+static float hud_text(SpriteBatch *b, const SpriteAtlas *at, float x, float y, float px,
+                      const char *str, SDL_Color color) {
+    for (; *str; str++, x += 4 * px) {
+        Uint16 g = hud_glyph(*str);
+        for (int bit = 0; bit < 15; bit++) {
+            if (!(g & (1u << (14 - bit)))) continue;
+            SDL_FRect r = { x + (bit % 3) * px, y + (bit / 3) * px, px, px };
+            sprite_batch_fill(b, at, LAYER_HUD, &r, color);
+        }
+    }
+    return x;
+}
+
+// The overlay: last frame and recent p50/p99 in ms, a bar of the last
+// frame split by phase, one swatch and time per phase, and a graph of the
+// recent frames against the 60 Hz budget
+static void prof_draw_hud(SpriteBatch *b, const SpriteAtlas *at) {
+    static const SDL_Color phase_color[PROF_PHASES] = {
+        { 160, 160, 160, 255 }, {  80, 200,  80, 255 }, { 170,  90, 220, 255 },
+        {  70, 130, 240, 255 }, { 240, 150,  40, 255 }, { 240, 220,  60, 255 },
+        {  90,  90,  90, 255 },
+    };
+    const SDL_Color text = { 255, 255, 255, 255 }, over = { 230, 60, 60, 255 };
+    const SDL_Color panel = { 0, 0, 0, 170 };
+    const float budget = 1000.f / 60.f, x0 = 8, y0 = 8, ms_px = 12.f;
+    if (!prof.ring_n) return;
+
+    SDL_FRect bg = { x0 - 4, y0 - 4, 8 + 128 * 2 + 8, 8 + 12 + 12 + 12 * 4 + 64 + 8 };
+    sprite_batch_fill(b, at, LAYER_HUD, &bg, panel);
+
+    int last = (prof.ring_pos + PROF_RING - 1) % PROF_RING;
+    float p50, p99;
+    char line[64];
+    prof_recent_percentiles(&p50, &p99);
+    SDL_snprintf(line, sizeof line, "%.1fms p50 %.1f p99 %.1f", prof.ring[last], p50, p99);
+    hud_text(b, at, x0, y0, 2, line, text);
+
+    float x = x0, y = y0 + 14;
+    for (int p = 0; p < PROF_PHASES; p++) {
+        SDL_FRect r = { x, y, prof.ring_phase[last][p] * ms_px, 8 };
+        sprite_batch_fill(b, at, LAYER_HUD, &r, phase_color[p]);
+        x += r.w;
+    }
+    SDL_FRect mark = { x0 + budget * ms_px, y - 2, 1, 12 };
+    sprite_batch_fill(b, at, LAYER_HUD, &mark, text);
+
+    for (int p = 0; p < PROF_PHASES; p++) {
+        float sx = x0 + (p % 2) * 128, sy = y0 + 26 + (p / 2) * 12;
+        SDL_FRect sw = { sx, sy, 8, 8 };
+        sprite_batch_fill(b, at, LAYER_HUD, &sw, phase_color[p]);
+        SDL_snprintf(line, sizeof line, "%.2f", prof.ring_phase[last][p]);
+        hud_text(b, at, sx + 12, sy - 1, 2, line, text);
+    }
+
+    // Graph, oldest frame on the left, 2 px per frame and 3 px per ms
+    float gy = y0 + 26 + 4 * 12 + 64;
+    int shown = prof.ring_n < 128 ? prof.ring_n : 128;
+    for (int k = 0; k < shown; k++) {
+        int i = (prof.ring_pos + PROF_RING - shown + k) % PROF_RING;
+        float h = prof.ring[i] * 3.f;
+        if (h > 64) h = 64;
+        SDL_FRect r = { x0 + 2 * k, gy - h, 2, h };
+        sprite_batch_fill(b, at, LAYER_HUD, &r,
+                          prof.ring[i] > budget + 0.5f ? over : phase_color[PROF_SIM]);
+    }
+    SDL_FRect line60 = { x0, gy - budget * 3.f, 256, 1 };
+    sprite_batch_fill(b, at, LAYER_HUD, &line60, text);
+}
+
+// ---------------------------------------------------------------------------
+// Frame-time governor
+//
+// With --frame-budget MS the game trades picture quality for frame rate.
+// Every GOV_WINDOW frames the governor averages the time from one present
+// to the next against the budget, along with its CPU part (up to the
+// present call) and the time spent in the present, where the GPU's work
+// shows up. Over budget, it moves one level down a fixed ladder of
+// quality settings. Once frames have kept within budget for a while it
+// tries one level back up. A step up that is undone soon after makes the
+// next try wait twice as long, so a level the machine cannot hold is not
+// retried every few seconds. Every decision is printed with the times
+// behind it.
+//
+// Each level sets the resolution the game is drawn at, before it is
+// scaled up to the window, the texture filtering of the atlas and the
+// scaled-down frame, and the share of sparks drawn. Only drawing changes,
+// never the simulation. Sprites already sit in the atlas at their
+// on-screen size, so the resolution is also the sprite level of detail.
+// ---------------------------------------------------------------------------
+
+#define GOV_WINDOW      30      // frames averaged per decision
+#define GOV_OVER        1.10    // over budget above this share of it
+#define GOV_UNDER       1.02    // within budget below it
+#define GOV_UP_AFTER_S  2.0     // within budget this long before a step up
+#define GOV_UP_MAX_S    32.0
+#define GOV_SETTLE_S    4.0     // a step down this soon after a step up undoes it
+
+static const struct {
+    float scale;                // render resolution, share of the window's
+    int   linear;               // bilinear filtering, else nearest
+    int   spark_stride;         // draw every Nth spark
+} GOV_LEVELS[] = {
+    { 1.00f, 1, 1 },
+    { 1.00f, 1, 2 },
+    { 0.75f, 1, 2 },
+    { 0.75f, 1, 4 },
+    { 0.50f, 0, 4 },
+    { 0.50f, 0, 8 },
+};
+#define GOV_LEVEL_COUNT ((int)SDL_arraysize(GOV_LEVELS))
+
+static struct {
+    int          on, level;
+    double       budget_ms, tick_ms;
+    Uint64       t_last;                // end of the last frame timed, 0: none
+    int          n;                     // frames in the current window
+    double       sum_ms, sum_cpu_ms, sum_present_ms;
+    double       t_change, t_up;        // seconds, counter based
+    double       up_after;              // seconds within budget before a step up
+    SDL_Texture *rt;                    // reduced-resolution frame, or NULL
+    int          rt_w, rt_h;            // size of rt, or of the last that failed
+} gov;
+
+static void gov_print_level(const char *why) {
+    printf("governor: %s level %d: %d%% resolution, %s filtering, 1/%d sparks\n", why,
+           gov.level, (int)(GOV_LEVELS[gov.level].scale * 100.f + .5f),
+           GOV_LEVELS[gov.level].linear ? "linear" : "nearest",
+           GOV_LEVELS[gov.level].spark_stride);
+    fflush(stdout);
+}
+
+static void gov_start(double budget_ms) {
+    SDL_zero(gov);
+    gov.on        = 1;
+    gov.budget_ms = budget_ms;
+    gov.tick_ms   = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    gov.up_after  = GOV_UP_AFTER_S;
+    printf("governor: %.2f ms budget\n", budget_ms);
+    gov_print_level("starting at");
+}
+
+// The frame between the last timed one and the next was not a normal one
+// (paused, or slept on events): start timing again from the next
+static void gov_skip(void) {
+    gov.t_last = 0;
+}
+
+// Time a frame: `t0` when its work began, `t_present` when it was handed to
+// SDL_RenderPresent and `t_end` when that returned. Returns 1 if the level
+// changed.
+static int gov_frame(Uint64 t0, Uint64 t_present, Uint64 t_end) {
+    if (gov.t_last) {
+        gov.sum_ms     += (double)(t_end - gov.t_last) * gov.tick_ms;
+        gov.sum_cpu_ms += (double)(t_present - t0) * gov.tick_ms;
+        gov.sum_present_ms += (double)(t_end - t_present) * gov.tick_ms;
+        gov.n++;
+    }
+    gov.t_last = t_end;
+    if (gov.n < GOV_WINDOW) return 0;
+
+    double ms = gov.sum_ms / gov.n, cpu = gov.sum_cpu_ms / gov.n;
+    double present = gov.sum_present_ms / gov.n;
+    double now = (double)t_end * gov.tick_ms / 1000.0;
+    gov.n = 0;
+    gov.sum_ms = gov.sum_cpu_ms = gov.sum_present_ms = 0.0;
+    const char *why;
+    int to = gov.level;
+    if (ms > gov.budget_ms * GOV_OVER) {
+        if (to == GOV_LEVEL_COUNT - 1) return 0;
+        to++;
+        why = "over budget,";
+        if (gov.t_up && now - gov.t_up < GOV_SETTLE_S) {
+            gov.up_after = SDL_min(gov.up_after * 2.0, GOV_UP_MAX_S);
+            why = "over budget after a step up,";
+        }
+    } else if (ms <= gov.budget_ms * GOV_UNDER && to > 0 && now - gov.t_change >= gov.up_after) {
+        to--;
+        gov.t_up = now;
+        why = "within budget,";
+    } else {
+        return 0;
+    }
+    printf("governor: %.2f ms per frame (%.2f ms CPU, %.2f ms in present) "
+           "against %.2f ms; next step up after %.0f s within budget\n",
+           ms, cpu, present, gov.budget_ms, gov.up_after);
+    gov.level    = to;
+    gov.t_change = now;
+    gov_print_level(why);
+    return 1;
+}
+
+// The texture to draw the frame into at the current level, remade when the
+// level or the window size changes; NULL to draw straight to the window. A
+// size the renderer refused is not asked for again.
+static SDL_Texture *gov_target(SDL_Renderer *ren) {
+    float sc = GOV_LEVELS[gov.level].scale;
+    int ow, oh;
+    if (sc >= 1.f || SDL_GetRendererOutputSize(ren, &ow, &oh) != 0) return NULL;
+    // The game's part of the window: as big as fits at WIN_W x WIN_H's aspect
+    float fit = SDL_min((float)ow / WIN_W, (float)oh / WIN_H) * sc;
+    int w = (int)(WIN_W * fit + .5f), h = (int)(WIN_H * fit + .5f);
+    if (gov.rt_w == w && gov.rt_h == h) return gov.rt;
+    if (gov.rt) SDL_DestroyTexture(gov.rt);
+    gov.rt = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    gov.rt_w = w;
+    gov.rt_h = h;
+    if (!gov.rt) {
+        fprintf(stderr, "Warning: no %dx%d render target: %s\n", w, h, SDL_GetError());
+        return NULL;
+    }
+    SDL_SetTextureScaleMode(gov.rt, GOV_LEVELS[gov.level].linear ? SDL_ScaleModeLinear
+                                                                 : SDL_ScaleModeNearest);
+    return gov.rt;
+}
+
+static void gov_stop(void) {
+    if (gov.rt) SDL_DestroyTexture(gov.rt);
+    SDL_zero(gov);
+}
+
+// ---------------------------------------------------------------------------
+// Fixed-step simulation
+//
+// All game logic advances in steps of exactly SIM_DT seconds, whatever the
+// display rate, so a run plays out the same at 30, 60 or 144 Hz and the
+// projectile never moves more than a few pixels between collision tests.
+// The game runs a step each time real time reaches the next one (on the
+// simulation thread, see below); rendering blends each entity's last two
+// positions by how far real time has got past the last step. Steps only
+// report sound cues; playing them is up to the caller.
+//
+// Birds, shells and explosions live in fixed-size pools stored as
+// structure of arrays. Live entities are packed at the front of each pool
+// and removed by moving the last one into the gap, so every update is a
+// straight loop over contiguous floats and nothing is allocated per step.
+//
+// Shells are tested against birds through a uniform grid over the play
+// field, rebuilt every step, using the boxes each one swept through during
+// the step so a fast shell cannot pass through a bird between two steps.
+// Boxes that touch are then checked against the bird's collision mask, so
+// only a shell that reaches the bird itself, not the sky around it, hits.
+//
+// Each explosion also throws out a burst of sparks, kept in a particle
+// pool of the same layout. They are moved by a kernel that handles four or
+// eight particles per instruction where the CPU allows; every path does
+// the same float operations in the same order, so a run does not depend
+// on which one the machine picked.
+// ---------------------------------------------------------------------------
+
+#define SIM_HZ        120
+#define SIM_DT        (1.0 / SIM_HZ)
+#define SIM_MAX_FRAME 0.25  // real time longer than this is dropped (stalls)
+
+#define SIM_MAX_BIRDS 16384
+#define SIM_MAX_SHOTS 16384
+#define SIM_MAX_BOOMS 16384
+#define SIM_MAX_PARTS 65536
+
+// Explosion sparks
+#define PART_PER_BOOM 96
+#define PART_LIFE     0.9f      // seconds, the longest a spark lasts
+#define PART_SPEED    260.f     // px/s, the fastest a spark leaves
+#define PART_GRAVITY  240.f     // px/s^2
+#define PART_DRAG     0.985f    // velocity kept per step
+#define PART_SIZE     3.f
+
+// Grid cells are at least this big, and at least as big as a bird's swept
+// box, so a bird covers at most 2x2 cells and a shell too
+#define HIT_GRID_MIN_CELL  64
+#define HIT_GRID_MAX_CELLS (((WIN_W + HIT_GRID_MIN_CELL - 1) / HIT_GRID_MIN_CELL) * \
+                            ((WIN_H + HIT_GRID_MIN_CELL - 1) / HIT_GRID_MIN_CELL))
+
+// Collision broad phase
+enum { SIM_COLLIDE_GRID, SIM_COLLIDE_BRUTE };
+
+// Player input collected between steps
+enum { SIM_IN_FIRE = 1 << 0 };
+
+// Sound cues raised by a step
+enum { SIM_EV_CANON = 1 << 0, SIM_EV_EXPLOSION = 1 << 1, SIM_EV_WINNER = 1 << 2 };
+
+typedef struct {
+    int    n;
+    float  x[SIM_MAX_BIRDS], y[SIM_MAX_BIRDS], vx[SIM_MAX_BIRDS];
+    float  px[SIM_MAX_BIRDS];       // x before the last step
+    float  anim[SIM_MAX_BIRDS];     // time into the current wing frame
+    Uint8  frame[SIM_MAX_BIRDS];
+} BirdPool;
+
+typedef struct {
+    int    n;
+    float  x[SIM_MAX_SHOTS], y[SIM_MAX_SHOTS];
+    float  py[SIM_MAX_SHOTS];       // y before the last step
+} ShotPool;
+
+typedef struct {
+    int    n;
+    float  x[SIM_MAX_BOOMS], y[SIM_MAX_BOOMS];
+    float  timer[SIM_MAX_BOOMS];    // seconds left on screen
+} BoomPool;
+
+typedef struct {
+    int    n;
+    float  x[SIM_MAX_PARTS], y[SIM_MAX_PARTS];
+    float  vx[SIM_MAX_PARTS], vy[SIM_MAX_PARTS];
+    float  life[SIM_MAX_PARTS];     // seconds left; the spark fades with it
+} PartPool;
+
+// Birds binned by the grid cells their swept boxes overlap, bird indices of
+// cell c in item[start[c]] .. item[start[c + 1] - 1]; rebuilt every step
+typedef struct {
+    int    cell, cols, rows;
+    int    start[HIT_GRID_MAX_CELLS + 1];
+    int    fill[HIT_GRID_MAX_CELLS];
+    Uint16 item[4 * SIM_MAX_BIRDS];
+    Uint8  bird_hit[SIM_MAX_BIRDS];
+    Uint8  shot_hit[SIM_MAX_SHOTS];
+} HitGrid;
+
+typedef struct {
+    // Layout, fixed for the whole run
+    float  bw, bh;                  // bird (and explosion) size
+    float  cx, cy, cw, ch;          // cannon rect
+    float  pw, ph;                  // projectile size
+    int    level_birds;             // birds in each wave
+    int    collide;                 // SIM_COLLIDE_*
+    const CollisionMask *bird_mask[2];  // per wing frame, NULL: box only
+    float  hx, hy, hw, hh;          // a bird's hit box, within bw x bh
+
+    BirdPool birds;
+    ShotPool shots;
+    BoomPool booms;
+    PartPool parts;
+    HitGrid  grid;                  // scratch for the hits phase
+    int      part_isa;              // ISA_* path of the particle kernel
+    Uint32   seed;                  // spark directions, speeds and lives
+
+    // Cannon firing animation
+    int    canon_play, canon_frame, proj_spawn;
+    double canon_acc;
+
+    // Winner display, shown once a wave is shot down
+    int    winner_active;
+    double winner_timer;
+
+    // Totals for the run
+    long   fired, kills;
+} SimState;
+
+static const float BIRD_FRAME_TIME = 0.18f;
+
+static int sim_spawn_bird(SimState *s, float x, float y, float vx) {
+    BirdPool *b = &s->birds;
+    if (b->n == SIM_MAX_BIRDS) return 0;
+    int i = b->n++;
+    b->x[i] = b->px[i] = x;
+    b->y[i] = y;
+    b->vx[i] = vx;
+    b->anim[i] = 0.f;
+    b->frame[i] = 0;
+    return 1;
+}
+
+static int sim_spawn_shot(SimState *s, float x, float y) {
+    ShotPool *p = &s->shots;
+    if (p->n == SIM_MAX_SHOTS) return 0;
+    int i = p->n++;
+    p->x[i] = x;
+    p->y[i] = p->py[i] = y;
+    return 1;
+}
+
+// Uniform 0..1 from the run's own LCG, so runs repeat exactly
+static float sim_randf(SimState *s) {
+    s->seed = s->seed * 1664525u + 1013904223u;
+    return (float)(s->seed >> 8) / (1u << 24);
+}
+
+// A burst of sparks from the middle of a bird, as many as the pool holds
+static void sim_spawn_sparks(SimState *s, float x, float y) {
+    PartPool *p = &s->parts;
+    for (int k = 0; k < PART_PER_BOOM && p->n < SIM_MAX_PARTS; k++) {
+        int i = p->n++;
+        float a = sim_randf(s) * 6.2831853f, v = (0.15f + 0.85f * sim_randf(s)) * PART_SPEED;
+        p->x[i]    = x;
+        p->y[i]    = y;
+        p->vx[i]   = cosf(a) * v;
+        p->vy[i]   = sinf(a) * v - 0.25f * PART_SPEED;
+        p->life[i] = (0.4f + 0.6f * sim_randf(s)) * PART_LIFE;
+    }
+}
+
+static int sim_spawn_boom(SimState *s, float x, float y) {
+    BoomPool *e = &s->booms;
+    if (e->n == SIM_MAX_BOOMS) return 0;
+    int i = e->n++;
+    e->x[i] = x;
+    e->y[i] = y;
+    e->timer[i] = (float)EXPLOSION_TIME;
+    sim_spawn_sparks(s, x + s->bw * 0.5f, y + s->bh * 0.5f);
+    return 1;
+}
+
+static void sim_kill_bird(SimState *s, int i) {
+    BirdPool *b = &s->birds;
+    int j = --b->n;
+    b->x[i] = b->x[j];  b->y[i] = b->y[j];  b->vx[i] = b->vx[j];
+    b->px[i] = b->px[j];  b->anim[i] = b->anim[j];  b->frame[i] = b->frame[j];
+}
+
+static void sim_kill_shot(SimState *s, int i) {
+    ShotPool *p = &s->shots;
+    int j = --p->n;
+    p->x[i] = p->x[j];  p->y[i] = p->y[j];  p->py[i] = p->py[j];
+}
+
+static void sim_kill_boom(SimState *s, int i) {
+    BoomPool *e = &s->booms;
+    int j = --e->n;
+    e->x[i] = e->x[j];  e->y[i] = e->y[j];  e->timer[i] = e->timer[j];
+}
+
+// A wave of birds entering from the right: the first one where the single
+// bird of the original game flew, the rest queued behind it in eight lanes
+// across the top half of the window at slightly different speeds
+static void sim_spawn_wave(SimState *s) {
+    const float lane_h = (WIN_H / 2 - 12) / 8.f;
+    for (int i = 0; i < s->level_birds; i++) {
+        float x = WIN_W + 10 + (i / 8) * (s->bw + 24) + (i * 37 % 17);
+        float y = 12 + (i % 8) * lane_h;
+        if (!sim_spawn_bird(s, x, y, 180.f * (1.f + (i * 7 % 5) * 0.0625f))) break;
+    }
+}
+
+static void sim_init(SimState *s, int bw, int bh, int cw, int ch, int level_birds) {
+    SDL_zerop(s);
+    s->bw = (float)bw;  s->bh = (float)bh;
+    s->cw = (float)cw;  s->ch = (float)ch;
+    s->cx = (WIN_W - cw) / 2.f;
+    s->cy = (float)(WIN_H - ch - 8);
+    s->pw = 10;         s->ph = 10;
+    s->hw = (float)bw;  s->hh = (float)bh;
+    s->level_birds = level_birds;
+    s->part_isa = cpu_best_isa();
+    s->seed = 1;
+
+    // The swept box is up to a step's flight (under 2 px) wider than a bird
+    int cell = HIT_GRID_MIN_CELL;
+    if (cell < bw + 4) cell = bw + 4;
+    if (cell < bh)     cell = bh;
+    s->grid.cell = cell;
+    s->grid.cols = (WIN_W + cell - 1) / cell;
+    s->grid.rows = (WIN_H + cell - 1) / cell;
+    sim_spawn_wave(s);
+}
+
+// One step is a fixed sequence of phases, each returning the SIM_EV_* cues
+// it raised. They are separate so --bench-sim can time them one by one.
+typedef Uint32 (*SimPhaseFn)(SimState *s, Uint32 input);
+
+// Start the cannon on a click, unless it is already firing
+static Uint32 sim_phase_input(SimState *s, Uint32 input) {
+    if ((input & SIM_IN_FIRE) && !s->canon_play) {
+        s->canon_play  = 1;
+        s->canon_acc   = 0.0;
+        s->canon_frame = 0;
+        s->proj_spawn  = 0;
+    }
+    return 0;
+}
+
+// Fly the birds right to left, wrapping round, and flap their wings
+static Uint32 sim_phase_birds(SimState *s, Uint32 input) {
+    (void)input;
+    BirdPool *b = &s->birds;
+    const float dt = (float)SIM_DT, wrap = -s->bw - 10;
+    memcpy(b->px, b->x, sizeof b->x[0] * b->n);
+    for (int i = 0; i < b->n; i++) {
+        float x = b->x[i] - b->vx[i] * dt;
+        b->x[i] = x < wrap ? WIN_W + 10 : x;
+        float a = b->anim[i] + dt;
+        int flip = a >= BIRD_FRAME_TIME;
+        b->anim[i] = flip ? a - BIRD_FRAME_TIME : a;
+        b->frame[i] ^= (Uint8)flip;
+    }
+    return 0;
+}
+
+// Animate cannon firing; a shell leaves on the last frame
+static Uint32 sim_phase_cannon(SimState *s, Uint32 input) {
+    (void)input;
+    if (!s->canon_play) return 0;
+    s->canon_acc += SIM_DT;
+    if (s->canon_acc >= CANNON_FRAME_TIME) {
+        s->canon_acc -= CANNON_FRAME_TIME;
+        s->canon_frame++;
+        if (s->canon_frame >= CANNON_FRAMES) {
+            s->canon_play  = 0;
+            s->canon_frame = 0;
+            s->proj_spawn  = 0;
+        }
+    }
+    if (s->canon_frame == CANNON_FRAMES - 1 && !s->proj_spawn) {
+        s->proj_spawn = 1;
+        if (sim_spawn_shot(s, s->cx + s->cw * 0.5f - s->pw * 0.5f,
+                           s->cy + s->ch * 0.15f)) {
+            s->fired++;
+            return SIM_EV_CANON;
+        }
+    }
+    return 0;
+}
+
+// Move the shells up and drop those that left the window
+static Uint32 sim_phase_shots(SimState *s, Uint32 input) {
+    (void)input;
+    ShotPool *p = &s->shots;
+    const float dy = PROJECTILE_SPEED * (float)SIM_DT, top = -50 - s->ph;
+    memcpy(p->py, p->y, sizeof p->y[0] * p->n);
+    for (int i = 0; i < p->n; i++)
+        p->y[i] -= dy;
+    for (int i = p->n - 1; i >= 0; i--)
+        if (p->y[i] < top) sim_kill_shot(s, i);
+    return 0;
+}
+
+// Particle kernels: gravity, then position, drag and fade for particles
+// [i, n). The vector paths finish their last partial block with the scalar
+// one.
+static void part_update_scalar(PartPool *p, int i, int n) {
+    const float dt = (float)SIM_DT, g = PART_GRAVITY * (float)SIM_DT;
+    for (; i < n; i++) {
+        float vx = p->vx[i], vy = p->vy[i] + g;
+        p->x[i]    += vx * dt;
+        p->y[i]    += vy * dt;
+        p->vx[i]    = vx * PART_DRAG;
+        p->vy[i]    = vy * PART_DRAG;
+        p->life[i] -= dt;
+    }
+}
+
+#ifdef ISA_HAVE_X86
+__attribute__((target("sse2")))
+static void part_update_sse2(PartPool *p, int n) {
+    const __m128 dt = _mm_set1_ps((float)SIM_DT), g = _mm_set1_ps(PART_GRAVITY * (float)SIM_DT);
+    const __m128 drag = _mm_set1_ps(PART_DRAG);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 vx = _mm_loadu_ps(p->vx + i);
+        __m128 vy = _mm_add_ps(_mm_loadu_ps(p->vy + i), g);
+        _mm_storeu_ps(p->x + i, _mm_add_ps(_mm_loadu_ps(p->x + i), _mm_mul_ps(vx, dt)));
+        _mm_storeu_ps(p->y + i, _mm_add_ps(_mm_loadu_ps(p->y + i), _mm_mul_ps(vy, dt)));
+        _mm_storeu_ps(p->vx + i, _mm_mul_ps(vx, drag));
+        _mm_storeu_ps(p->vy + i, _mm_mul_ps(vy, drag));
+        _mm_storeu_ps(p->life + i, _mm_sub_ps(_mm_loadu_ps(p->life + i), dt));
+    }
+    part_update_scalar(p, i, n);
+}
+
+__attribute__((target("avx2")))
+static void part_update_avx2(PartPool *p, int n) {
+    const __m256 dt = _mm256_set1_ps((float)SIM_DT), g = _mm256_set1_ps(PART_GRAVITY * (float)SIM_DT);
+    const __m256 drag = _mm256_set1_ps(PART_DRAG);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 vx = _mm256_loadu_ps(p->vx + i);
+        __m256 vy = _mm256_add_ps(_mm256_loadu_ps(p->vy + i), g);
+        _mm256_storeu_ps(p->x + i, _mm256_add_ps(_mm256_loadu_ps(p->x + i), _mm256_mul_ps(vx, dt)));
+        _mm256_storeu_ps(p->y + i, _mm256_add_ps(_mm256_loadu_ps(p->y + i), _mm256_mul_ps(vy, dt)));
+        _mm256_storeu_ps(p->vx + i, _mm256_mul_ps(vx, drag));
+        _mm256_storeu_ps(p->vy + i, _mm256_mul_ps(vy, drag));
+        _mm256_storeu_ps(p->life + i, _mm256_sub_ps(_mm256_loadu_ps(p->life + i), dt));
+    }
+    part_update_scalar(p, i, n);
+}
+#endif
+
+static void part_update(PartPool *p, int isa) {
+#ifdef ISA_HAVE_X86
+    if (isa == ISA_AVX2) { part_update_avx2(p, p->n); return; }
+    if (isa == ISA_SSE2) { part_update_sse2(p, p->n); return; }
+#endif
+    (void)isa;
+    part_update_scalar(p, 0, p->n);
+}
+
+// Drop burnt-out particles, keeping the order of the rest
+static void part_compact(PartPool *p) {
+    int i = 0;
+    while (i < p->n && p->life[i] > 0.f) i++;
+    int k = i;
+    for (; i < p->n; i++) {
+        if (p->life[i] <= 0.f) continue;
+        p->x[k]  = p->x[i];   p->y[k]  = p->y[i];
+        p->vx[k] = p->vx[i];  p->vy[k] = p->vy[i];
+        p->life[k] = p->life[i];
+        k++;
+    }
+    p->n = k;
+}
+
+// Does shell j touch bird i, each taken over the box it swept through
+// during the last step? A bird that wrapped round only counts where it is.
+// Boxes that overlap go on to the mask of the bird's current wing frame,
+// with the shell's swept box widened by the bird's own slide.
+static inline int sim_shot_hits_bird(const SimState *s, int j, int i) {
+    const BirdPool *b = &s->birds;
+    const ShotPool *p = &s->shots;
+    float bx = b->x[i], by = b->y[i], slide = 0.f;
+    if (b->px[i] > bx) slide = b->px[i] - bx;
+    float sx = p->x[j], sy = p->y[j], sh = s->ph + (p->py[j] - sy);
+    if (!rects_intersectf(sx, sy, s->pw, sh, bx + s->hx, by + s->hy, s->hw + slide, s->hh))
+        return 0;
+
+    const CollisionMask *m = s->bird_mask[b->frame[i]];
+    if (!m) return 1;
+    // Truncation rounds a negative start up, but that part is clipped anyway
+    float ex = sx + s->pw - bx, ey = sy + sh - by;
+    int x1 = (int)ex, y1 = (int)ey;
+    x1 += x1 < ex;
+    y1 += y1 < ey;
+    return mask_hits_rect(m, (int)(sx - bx - slide), (int)(sy - by), x1, y1);
+}
+
+// Grid cells under a box, clamped to the field; anything outside it lands
+// in the border cells
+static void hit_grid_span(const HitGrid *g, float x0, float y0, float x1, float y1,
+                          int *c0, int *r0, int *c1, int *r1) {
+    int v[4] = { (int)floorf(x0 / g->cell), (int)floorf(y0 / g->cell),
+                 (int)floorf(x1 / g->cell), (int)floorf(y1 / g->cell) };
+    for (int k = 0; k < 4; k++) {
+        int hi = (k & 1) ? g->rows - 1 : g->cols - 1;
+        v[k] = v[k] < 0 ? 0 : v[k] > hi ? hi : v[k];
+    }
+    *c0 = v[0];  *r0 = v[1];
+    // At most two cells each way by the choice of cell size; the clamp
+    // keeps item[] in bounds regardless
+    *c1 = v[2] > v[0] + 1 ? v[0] + 1 : v[2];
+    *r1 = v[3] > v[1] + 1 ? v[1] + 1 : v[3];
+}
+
+static void hit_grid_bird_span(const SimState *s, int i, int *c0, int *r0, int *c1, int *r1) {
+    const BirdPool *b = &s->birds;
+    float x1 = (b->px[i] > b->x[i] ? b->px[i] : b->x[i]) + s->hx + s->hw;
+    float y0 = b->y[i] + s->hy;
+    hit_grid_span(&s->grid, b->x[i] + s->hx, y0, x1, y0 + s->hh, c0, r0, c1, r1);
+}
+
+// Bin every bird by counting sort: count per cell, prefix sum, fill
+static void hit_grid_build(SimState *s) {
+    HitGrid *g = &s->grid;
+    int cells = g->cols * g->rows, c0, r0, c1, r1;
+    memset(g->start, 0, sizeof g->start[0] * (cells + 1));
+    for (int i = 0; i < s->birds.n; i++) {
+        hit_grid_bird_span(s, i, &c0, &r0, &c1, &r1);
+        for (int r = r0; r <= r1; r++)
+            for (int c = c0; c <= c1; c++)
+                g->start[r * g->cols + c + 1]++;
+    }
+    for (int c = 0; c < cells; c++) {
+        g->start[c + 1] += g->start[c];
+        g->fill[c] = g->start[c];
+    }
+    for (int i = 0; i < s->birds.n; i++) {
+        hit_grid_bird_span(s, i, &c0, &r0, &c1, &r1);
+        for (int r = r0; r <= r1; r++)
+            for (int c = c0; c <= c1; c++)
+                g->item[g->fill[r * g->cols + c]++] = (Uint16)i;
+    }
+}
+
+// Lowest-numbered bird still flying that shell j touches, or -1. Both
+// searches give the same answer; the grid only looks in nearby cells.
+static int hit_first_brute(const SimState *s, int j) {
+    for (int i = 0; i < s->birds.n; i++)
+        if (!s->grid.bird_hit[i] && sim_shot_hits_bird(s, j, i)) return i;
+    return -1;
+}
+
+static int hit_first_grid(const SimState *s, int j) {
+    const HitGrid  *g = &s->grid;
+    const ShotPool *p = &s->shots;
+    int c0, r0, c1, r1, best = -1;
+    hit_grid_span(g, p->x[j], p->y[j], p->x[j] + s->pw, p->py[j] + s->ph,
+                  &c0, &r0, &c1, &r1);
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            int cell = r * g->cols + c;
+            for (int k = g->start[cell]; k < g->start[cell + 1]; k++) {
+                int i = g->item[k];
+                if ((best < 0 || i < best) && !g->bird_hit[i] &&
+                    sim_shot_hits_bird(s, j, i))
+                    best = i;
+            }
+        }
+    }
+    return best;
+}
+
+// Each shell takes down the first bird it touches; shooting down the whole
+// wave brings up the winner display. Hits are marked first and the pools
+// compacted afterwards, so indices stay put while the grid is in use.
+static Uint32 sim_phase_hits(SimState *s, Uint32 input) {
+    (void)input;
+    BirdPool *b = &s->birds;
+    ShotPool *p = &s->shots;
+    HitGrid  *g = &s->grid;
+    if (b->n == 0 || p->n == 0) return 0;
+
+    memset(g->bird_hit, 0, b->n);
+    memset(g->shot_hit, 0, p->n);
+    if (s->collide == SIM_COLLIDE_GRID) hit_grid_build(s);
+    int hits = 0;
+    for (int j = 0; j < p->n; j++) {
+        int i = s->collide == SIM_COLLIDE_GRID ? hit_first_grid(s, j)
+                                               : hit_first_brute(s, j);
+        if (i < 0) continue;
+        g->bird_hit[i] = g->shot_hit[j] = 1;
+        sim_spawn_boom(s, b->x[i], b->y[i]);
+        hits++;
+    }
+    if (!hits) return 0;
+
+    for (int i = b->n - 1; i >= 0; i--)
+        if (g->bird_hit[i]) sim_kill_bird(s, i);
+    for (int j = p->n - 1; j >= 0; j--)
+        if (g->shot_hit[j]) sim_kill_shot(s, j);
+    s->kills += hits;
+
+    Uint32 ev = SIM_EV_EXPLOSION;
+    if (b->n == 0 && !s->winner_active) {
+        s->winner_active = 1;
+        s->winner_timer  = WINNER_TIME;
+        ev |= SIM_EV_WINNER;
+    }
+    return ev;
+}
+
+// Move the sparks and let them burn out
+static Uint32 sim_phase_sparks(SimState *s, Uint32 input) {
+    (void)input;
+    part_update(&s->parts, s->part_isa);
+    part_compact(&s->parts);
+    return 0;
+}
+
+// Count down the explosions, then the winner display, which ends with a
+// new wave
+static Uint32 sim_phase_timers(SimState *s, Uint32 input) {
+    (void)input;
+    BoomPool *e = &s->booms;
+    for (int i = 0; i < e->n; i++)
+        e->timer[i] -= (float)SIM_DT;
+    for (int i = e->n - 1; i >= 0; i--)
+        if (e->timer[i] <= 0.f) sim_kill_boom(s, i);
+    if (s->winner_active) {
+        s->winner_timer -= SIM_DT;
+        if (s->winner_timer <= 0.0) {
+            s->winner_active = 0;
+            sim_spawn_wave(s);
+        }
+    }
+    return 0;
+}
+
+static const struct { const char *name; SimPhaseFn fn; } SIM_PHASES[] = {
+    { "input",  sim_phase_input  },
+    { "birds",  sim_phase_birds  },
+    { "cannon", sim_phase_cannon },
+    { "shots",  sim_phase_shots  },
+    { "hits",   sim_phase_hits   },
+    { "sparks", sim_phase_sparks },
+    { "timers", sim_phase_timers },
+};
+#define SIM_PHASE_COUNT ((int)SDL_arraysize(SIM_PHASES))
+
+// Advance the game by one SIM_DT step; returns the SIM_EV_* cues raised
+static Uint32 sim_step(SimState *s, Uint32 input) {
+    Uint32 ev = 0;
+    for (int p = 0; p < SIM_PHASE_COUNT; p++)
+        ev |= SIM_PHASES[p].fn(s, input);
+    return ev;
+}
+
+static Uint64 hash_chain(Uint64 h, const void *data, size_t n) {
+    Uint64 pair[2] = { h, hash_bytes(data, n) };
+    return hash_bytes(pair, sizeof pair);
+}
+
+// Hash of everything a step can change, for comparing runs
+static Uint64 sim_hash(const SimState *s) {
+    const BirdPool *b = &s->birds;
+    const ShotPool *p = &s->shots;
+    const BoomPool *e = &s->booms;
+    const PartPool *q = &s->parts;
+    const double v[] = {
+        b->n, p->n, e->n, q->n,
+        s->canon_play, s->canon_frame, s->proj_spawn, s->canon_acc,
+        s->winner_active, s->winner_timer,
+    };
+    Uint64 h = hash_bytes(v, sizeof v);
+    h = hash_chain(h, b->x,     sizeof b->x[0] * b->n);
+    h = hash_chain(h, b->y,     sizeof b->y[0] * b->n);
+    h = hash_chain(h, b->anim,  sizeof b->anim[0] * b->n);
+    h = hash_chain(h, b->frame, sizeof b->frame[0] * b->n);
+    h = hash_chain(h, p->x,     sizeof p->x[0] * p->n);
+    h = hash_chain(h, p->y,     sizeof p->y[0] * p->n);
+    h = hash_chain(h, e->x,     sizeof e->x[0] * e->n);
+    h = hash_chain(h, e->timer, sizeof e->timer[0] * e->n);
+    h = hash_chain(h, q->x,     sizeof q->x[0] * q->n);
+    h = hash_chain(h, q->y,     sizeof q->y[0] * q->n);
+    h = hash_chain(h, q->life,  sizeof q->life[0] * q->n);
+    return h;
+}
+
+// Position `alpha` (0..1) of the way through the last step
+static inline float sim_lerpf(float prev, float cur, float alpha) {
+    return prev + (cur - prev) * alpha;
+}
+
+// Queue every spark, white-hot to red as it burns out, drawn back along its
+// last step by how far real time has got. All of them share the atlas
+// white block, so they go out with the rest of the frame.
+static void sim_draw_particles(const SimState *s, SpriteBatch *b, const SpriteAtlas *at,
+                               float alpha, int stride) {
+    const PartPool *p = &s->parts;
+    const float back = (float)SIM_DT * (alpha - 1.f), half = PART_SIZE * 0.5f;
+    for (int i = 0; i < p->n; i += stride) {
+        float t = p->life[i] * (1.f / PART_LIFE);
+        SDL_Color c = { 255, (Uint8)(60.f + 195.f * t), (Uint8)(200.f * t * t),
+                        (Uint8)(255.f * t) };
+        SDL_FRect r = { p->x[i] + p->vx[i] * back - half, p->y[i] + p->vy[i] * back - half,
+                        PART_SIZE, PART_SIZE };
+        sprite_batch_fill(b, at, LAYER_PARTICLES, &r, c);
+    }
+}
+
+// Scale a sprite of size `z` to `draw_w` wide, keeping its aspect. A sprite
+// that failed to load has no size, so it gets a square `draw_w` box instead.
+static void sim_draw_size(const SDL_Point *z, int draw_w, int *w, int *h) {
+    if (z->x <= 0 || z->y <= 0) {
+        *w = *h = draw_w;
+        return;
+    }
+    float sc = (float)draw_w / (float)z->x;
+    *w = (int)(z->x * sc + .5f);
+    *h = (int)(z->y * sc + .5f);
+}
+
+// Set up a run with the sprites drawn at their configured widths, heights
+// keeping the aspect of the whole sprites, and birds hit only within the
+// trimmed bounds of either wing frame
+static void sim_init_for_atlas(SimState *s, const SpriteAtlas *at, int level_birds) {
+    int bw, bh, cw, ch;
+    sim_draw_size(&at->size[SPR_BU1], BIRD_DRAW_W, &bw, &bh);
+    sim_draw_size(&at->size[SPR_CANO1], CANNON_DRAW_W, &cw, &ch);
+    sim_init(s, bw, bh, cw, ch, level_birds);
+
+    // Union of the frames' trims, scaled to draw size and rounded outwards
+    float x0 = (float)bw, y0 = (float)bh, x1 = 0.f, y1 = 0.f;
+    for (int f = SPR_BU1; f <= SPR_BU2; f++) {
+        const SDL_Rect *t = &at->trim[f];
+        if (t->w <= 0 || at->size[f].x <= 0 || at->size[f].y <= 0) continue;
+        float sx = (float)bw / at->size[f].x, sy = (float)bh / at->size[f].y;
+        x0 = SDL_min(x0, floorf(t->x * sx));
+        y0 = SDL_min(y0, floorf(t->y * sy));
+        x1 = SDL_max(x1, ceilf((t->x + t->w) * sx));
+        y1 = SDL_max(y1, ceilf((t->y + t->h) * sy));
+    }
+    if (x1 > x0 && y1 > y0) {
+        s->hx = x0;       s->hy = y0;
+        s->hw = x1 - x0;  s->hh = y1 - y0;
+    }
+}
+
+// Queue a whole game frame: the winner display, or the explosions, birds,
+// cannon and shells in flight, then every `spark_stride`th spark. Moving
+// things are drawn `alpha` of the way through the last step.
+static void sim_draw(const SimState *s, SpriteBatch *b, const SpriteAtlas *at, float alpha,
+                     int spark_stride) {
+    int win_w = at->size[SPR_WINNER].x, win_h = at->size[SPR_WINNER].y;
+
+    if (s->winner_active && win_w > 0) {
+        // Draw "WINNER" centered on screen
+        int dw = win_w, dh = win_h;
+        const int TW = WINNER_DRAW_W;
+        if (win_w > TW) {
+            float sc = (float)TW / (float)win_w;
+            dw = (int)(win_w * sc + 0.5f);
+            dh = (int)(win_h * sc + 0.5f);
+        }
+        SDL_FRect rw = { (WIN_W - dw) / 2, (WIN_H - dh) / 2, dw, dh };
+        sprite_batch_trimmed(b, at, LAYER_OVERLAY, SPR_WINNER, &rw);
+    }
+    else {
+        const BoomPool *booms = &s->booms;
+        for (int i = 0; i < booms->n; i++) {
+            SDL_FRect re = { (int)(booms->x[i] + 0.5f),
+                             (int)(booms->y[i] + 0.5f),
+                             s->bw, s->bh };
+            sprite_batch_trimmed(b, at, LAYER_WORLD, SPR_EXPLOSION, &re);
+        }
+
+        // A bird that just wrapped round is drawn where it is now
+        const BirdPool *birds = &s->birds;
+        for (int i = 0; i < birds->n; i++) {
+            float x = birds->px[i] >= birds->x[i]
+                    ? sim_lerpf(birds->px[i], birds->x[i], alpha) : birds->x[i];
+            SDL_FRect rb = { (int)(x + 0.5f),
+                             (int)(birds->y[i] + 0.5f),
+                             s->bw, s->bh };
+            sprite_batch_trimmed(b, at, LAYER_WORLD,
+                                 (birds->frame[i] == 0 ? SPR_BU1 : SPR_BU2),
+                                 &rb);
+        }
+
+        int cfidx = (s->canon_play ? s->canon_frame : 0);
+        if (cfidx < 0) cfidx = 0;
+        if (cfidx >= CANNON_FRAMES) cfidx = CANNON_FRAMES - 1;
+        SDL_FRect rc = { (int)(s->cx + 0.5f),
+                         (int)(s->cy + 0.5f),
+                         s->cw, s->ch };
+        sprite_batch_trimmed(b, at, LAYER_WORLD, SPR_CANO1 + cfidx, &rc);   // frames in a row
+
+        const ShotPool *shots = &s->shots;
+        const SDL_Color shot_color = { 220, 200, 60, 255 };
+        for (int i = 0; i < shots->n; i++) {
+            SDL_FRect rp = {
+                (int)(shots->x[i] + 0.5f),
+                (int)(sim_lerpf(shots->py[i], shots->y[i], alpha) + 0.5f),
+                s->pw, s->ph
+            };
+            sprite_batch_fill(b, at, LAYER_SHOTS, &rp, shot_color);
+        }
+    }
+    sim_draw_particles(s, b, at, alpha, spark_stride);
+}
+
+// Wait until the performance counter reaches `deadline`. SDL_Delay covers
+// most of it and a short spin the rest, since it can oversleep by a
+// millisecond or more.
+static void sleep_until(Uint64 deadline) {
+    double freq = (double)SDL_GetPerformanceFrequency();
+    for (;;) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now >= deadline) return;
+        double ms = (deadline - now) * 1000.0 / freq;
+        if (ms > 2.0) SDL_Delay((Uint32)(ms - 1.0));
+    }
+}
+
+// Render the game `seconds` into a run, clicking every 0.9 s as --bench-sim
+// does, with the software compositor and no window or GPU, and save the
+// frame as a PNG (--render-png). The same build and images always give the
+// same file, so frames can be compared against known-good ones.
+static int render_png(const char *path, double seconds, int filter, int level_birds) {
+    IMG_Init(IMG_INIT_PNG);
+    SDL_Surface *spr[SPR_COUNT] = {0};
+    sprite_cache_open(SPRITE_CACHE_FILE);
+    load_sprites(1, spr);
+    SpriteAtlas at;
+    SDL_Surface *page = atlas_pack(spr, &at);
+    CollisionMask mask[2];
+    SDL_zero(mask);
+    for (int f = 0; f < 2; f++) {
+        const SDL_Surface *b = spr[SPR_BU1 + f];
+        if (b) mask_build(b, BIRD_DRAW_W,
+                          (int)(b->h * ((float)BIRD_DRAW_W / (float)b->w) + .5f), &mask[f]);
+    }
+    sprite_cache_close(SPRITE_CACHE_FILE);
+
+    SimState *s = (SimState*)malloc(sizeof *s);
+    SoftTarget t;
+    SpriteBatch b;
+    SDL_zero(t);
+    SDL_zero(b);
+    int ok = page && s && soft_init(&t, WIN_W, WIN_H, page, filter);
+    if (ok) {
+        sim_init_for_atlas(s, &at, level_birds);
+        for (int f = 0; f < 2; f++)
+            if (mask[f].bits && mask[f].w == (int)s->bw && mask[f].h == (int)s->bh)
+                s->bird_mask[f] = &mask[f];
+        long steps = (long)(seconds * SIM_HZ + 0.5);
+        double click = 0.9;
+        for (long k = 0; k < steps; k++) {
+            Uint32 input = 0;
+            if (k == (long)ceil(click * SIM_HZ)) {
+                input = SIM_IN_FIRE;
+                click += 0.9;
+            }
+            sim_step(s, input);
+        }
+
+        soft_clear(&t, SKY_COLOR);
+        sprite_batch_begin(&b, NULL);
+        b.soft = &t;
+        sim_draw(s, &b, &at, 1.f, 1);
+        sprite_batch_flush(&b);
+        ok = soft_save_png(&t, path);
+        if (ok)
+            printf("%s: %.2f s in, %d birds, %d shells, %d explosions, %d sparks, %s\n",
+                   path, steps / (double)SIM_HZ, s->birds.n, s->shots.n, s->booms.n,
+                   s->parts.n, filter == SOFT_BILINEAR ? "bilinear" : "nearest");
+    } else {
+        fprintf(stderr, "render-png: out of memory or no sprites\n");
+    }
+
+    sprite_batch_free(&b);
+    soft_free(&t);
+    free(s);
+    for (int f = 0; f < 2; f++) mask_free(&mask[f]);
+    if (page) SDL_FreeSurface(page);
+    IMG_Quit();
+    return ok ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Simulation thread
+//
+// During the game the fixed steps run on a thread of their own, so a slow
+// present or a vsync wait on the main thread no longer holds them up. The
+// main thread keeps the window and the event queue: it forwards clicks and
+// pause toggles stamped with when they happened, and every step takes the
+// input that came before the step's own time, so a click lands in the same
+// step whatever the frame rate. The thread plays the steps' sound cues as
+// soon as they are raised.
+//
+// After each batch of steps the thread copies the live entities into a
+// snapshot and publishes it through a triple buffer: one snapshot being
+// written, one being drawn and one waiting, handed over by swapping slot
+// numbers with a single atomic exchange. The renderer only ever reads the
+// newest complete snapshot, and neither side waits for the other.
+//
+// If the thread cannot be started (or with --no-sim-thread), the main
+// thread runs the same steps between frames.
+// ---------------------------------------------------------------------------
+
+#define SIM_INPUT_QUEUE 64              // power of two
+#define SIM_VIEW_FRESH  4               // flag on `middle`: not yet taken by the reader
+
+enum { SIM_MSG_FIRE, SIM_MSG_PAUSE };
+
+typedef struct {
+    int    type;                        // SIM_MSG_*
+    Uint64 t;                           // performance counter when it happened
+} SimMsg;
+
+typedef struct {
+    SimState    *sim;                   // stepped by the simulation side only
+    SimState    *view;                  // three snapshots
+    Uint64       view_t[3];             // time each one shows
+    int          back, front;           // slot written / slot drawn
+    SDL_atomic_t middle;                // slot waiting, | SIM_VIEW_FRESH
+    SimMsg       queue[SIM_INPUT_QUEUE];
+    SDL_atomic_t head, tail;            // written by main / simulation side
+    SDL_atomic_t quit;
+    SDL_atomic_t prof_ticks[2];         // PROF_SIM, PROF_AUDIO since last collected
+    SDL_sem     *wake;                  // posted with every message
+    SDL_Thread  *thread;
+
+    // Simulation side only
+    Uint64       freq, step_ticks;
+    Uint64       next_step;             // time the next step brings the game to
+    Uint64       resume_in;             // next_step - pause time, while paused
+    int          paused, music_on;
+    Uint32       input;
+    Uint64       t_fire;                // click that started the cannon, until it fires
+    const GameAssets *assets;
+} SimRunner;
+
+// Copy what drawing needs: the layout and counters and the live part of
+// each pool, not the whole arrays or the hit grid
+static void sim_snapshot(SimState *d, const SimState *s) {
+    memcpy(d, s, offsetof(SimState, birds));
+#define SIM_COPY_LIVE(pool, f) \
+    memcpy(d->pool.f, s->pool.f, sizeof s->pool.f[0] * (size_t)s->pool.n)
+    d->birds.n = s->birds.n;
+    SIM_COPY_LIVE(birds, x);  SIM_COPY_LIVE(birds, y);  SIM_COPY_LIVE(birds, px);
+    SIM_COPY_LIVE(birds, frame);
+    d->shots.n = s->shots.n;
+    SIM_COPY_LIVE(shots, x);  SIM_COPY_LIVE(shots, y);  SIM_COPY_LIVE(shots, py);
+    d->booms.n = s->booms.n;
+    SIM_COPY_LIVE(booms, x);  SIM_COPY_LIVE(booms, y);
+    d->parts.n = s->parts.n;
+    SIM_COPY_LIVE(parts, x);  SIM_COPY_LIVE(parts, y);
+    SIM_COPY_LIVE(parts, vx); SIM_COPY_LIVE(parts, vy); SIM_COPY_LIVE(parts, life);
+#undef SIM_COPY_LIVE
+    d->canon_play    = s->canon_play;
+    d->canon_frame   = s->canon_frame;
+    d->winner_active = s->winner_active;
+    d->fired         = s->fired;
+    d->kills         = s->kills;
+}
+
+static void sim_runner_publish(SimRunner *r, Uint64 t) {
+    sim_snapshot(&r->view[r->back], r->sim);
+    r->view_t[r->back] = t;
+    r->back = SDL_AtomicSet(&r->middle, r->back | SIM_VIEW_FRESH) & 3;
+}
+
+// The newest snapshot and the time it shows; stays valid until the next call
+static const SimState *sim_runner_latest(SimRunner *r, Uint64 *t) {
+    if (SDL_AtomicGet(&r->middle) & SIM_VIEW_FRESH)
+        r->front = SDL_AtomicSet(&r->middle, r->front) & 3;
+    *t = r->view_t[r->front];
+    return &r->view[r->front];
+}
+
+// Forward input from the main thread; `t` is when it happened
+static void sim_runner_send(SimRunner *r, int type, Uint64 t) {
+    int head = SDL_AtomicGet(&r->head);
+    if ((unsigned)head - (unsigned)SDL_AtomicGet(&r->tail) == SIM_INPUT_QUEUE) return;
+    r->queue[head & (SIM_INPUT_QUEUE - 1)] = (SimMsg){ type, t };
+    SDL_AtomicSet(&r->head, head + 1);
+    if (r->wake) SDL_SemPost(r->wake);
+}
+
+// Vulture music plays while a wave is in the air; SDL_mixer is only called
+// when that changes
+static void sim_runner_music(SimRunner *r) {
+    const SimState *s = r->sim;
+    int want = r->assets->music && s->birds.n > 0 && !s->winner_active;
+    if (want == r->music_on) return;
+    if (want) Mix_PlayMusic(r->assets->music, -1);
+    else      Mix_HaltMusic();
+    r->music_on = want;
+}
+
+// Run every step due by `now`, each after the input that came before its
+// time, then play the cues and publish the result. Steps missed in a stall
+// longer than SIM_MAX_FRAME are dropped rather than caught up.
+static void sim_runner_advance(SimRunner *r, Uint64 now) {
+    const Uint64 stall = (Uint64)(SIM_MAX_FRAME * (double)r->freq);
+    int prof_on = prof.on;
+    Uint64 t0 = prof_on ? SDL_GetPerformanceCounter() : 0;
+    Uint32 ev = 0;
+    Uint64 t_shot = 0;
+    int stepped = 0;
+    if (!r->paused && now > r->next_step + stall) r->next_step = now - stall;
+    for (;;) {
+        int tail = SDL_AtomicGet(&r->tail), head = SDL_AtomicGet(&r->head);
+        for (; tail != head; tail++) {
+            const SimMsg *m = &r->queue[tail & (SIM_INPUT_QUEUE - 1)];
+            if (!r->paused && m->t > r->next_step) break;
+            // A click while paused still fires, on resume, and its latency
+            // is timed like any other with the pause left out: a click from
+            // before the pause has the pause added, one during it counts
+            // from the resume
+            if (m->type == SIM_MSG_PAUSE) {
+                if (!r->paused) {
+                    r->resume_in = r->next_step - m->t;
+                } else {
+                    Uint64 t_pause = r->next_step - r->resume_in;
+                    if (r->t_fire)
+                        r->t_fire = r->t_fire < t_pause ? r->t_fire + (m->t - t_pause) : m->t;
+                    r->next_step = m->t + r->resume_in;
+                }
+                r->paused = !r->paused;
+            } else {
+                r->input |= SIM_IN_FIRE;
+                if (!r->t_fire) r->t_fire = m->t;
+            }
+        }
+        SDL_AtomicSet(&r->tail, tail);
+        if (r->paused || r->next_step > now) break;
+        // The shot leaves on the last frame of the cannon animation, some
+        // steps after the click; a click while the cannon plays is ignored
+        Uint32 step_ev = sim_step(r->sim, r->input);
+        if (step_ev & SIM_EV_CANON) t_shot = r->t_fire;
+        if ((step_ev & SIM_EV_CANON) || !r->sim->canon_play) r->t_fire = 0;
+        ev |= step_ev;
+        r->input = 0;
+        r->next_step += r->step_ticks;
+        stepped = 1;
+    }
+    if (!stepped) return;
+    sim_runner_publish(r, r->next_step - r->step_ticks);
+    Uint64 t1 = prof_on ? SDL_GetPerformanceCounter() : 0;
+
+    const GameAssets *as = r->assets;
+    if (ev & SIM_EV_CANON)     sfx_play(assets_sfx(as, SFX_CANON), t_shot);
+    if (ev & SIM_EV_EXPLOSION) sfx_play(assets_sfx(as, SFX_EXPLOSION), 0);
+    if (ev & SIM_EV_WINNER)    sfx_play(assets_sfx(as, SFX_WINNER), 0);
+    sim_runner_music(r);
+    if (prof_on) {
+        SDL_AtomicAdd(&r->prof_ticks[0], (int)(t1 - t0));
+        SDL_AtomicAdd(&r->prof_ticks[1], (int)(SDL_GetPerformanceCounter() - t1));
+    }
+}
+
+static int sim_thread_main(void *data) {
+    SimRunner *r = (SimRunner*)data;
+    const double ms_per_tick = 1000.0 / (double)r->freq;
+    while (!SDL_AtomicGet(&r->quit)) {
+        sim_runner_advance(r, SDL_GetPerformanceCounter());
+        if (r->paused) {
+            SDL_SemWait(r->wake);
+            continue;
+        }
+        // Sleep to the next step, or until input comes
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (r->next_step > now)
+            SDL_SemWaitTimeout(r->wake, (Uint32)((r->next_step - now) * ms_per_tick) + 1);
+    }
+    return 0;
+}
+
+// Start stepping `sim` from now, drawing from `view` (three SimStates), on
+// a thread unless `threaded` is 0 or none can be made
+static void sim_runner_start(SimRunner *r, SimState *sim, SimState *view,
+                             const GameAssets *as, int threaded) {
+    SDL_zerop(r);
+    r->sim        = sim;
+    r->view       = view;
+    r->assets     = as;
+    r->freq       = SDL_GetPerformanceFrequency();
+    r->step_ticks = (Uint64)(SIM_DT * (double)r->freq + 0.5);
+    r->next_step  = SDL_GetPerformanceCounter() + r->step_ticks;
+    r->front = 0;
+    r->back  = 2;
+    SDL_AtomicSet(&r->middle, 1);
+    sim_snapshot(&view[0], sim);
+    r->view_t[0] = r->next_step - r->step_ticks;
+
+    if (as->music && sim->birds.n > 0) {
+        Mix_PlayMusic(as->music, -1);
+        Mix_VolumeMusic(MIX_MAX_VOLUME * 60 / 100);
+        r->music_on = 1;
+    }
+    if (!threaded) return;
+    r->wake   = SDL_CreateSemaphore(0);
+    r->thread = r->wake ? SDL_CreateThread(sim_thread_main, "aeroboo-sim", r) : NULL;
+    if (!r->thread) fprintf(stderr, "Warning: simulating on the main thread: %s\n", SDL_GetError());
+}
+
+// Move the simulation side's busy time into the current profiler frame
+static void sim_runner_prof(SimRunner *r) {
+    if (!prof.on) return;
+    prof.phase[PROF_SIM]   += (Uint64)(unsigned)SDL_AtomicSet(&r->prof_ticks[0], 0);
+    prof.phase[PROF_AUDIO] += (Uint64)(unsigned)SDL_AtomicSet(&r->prof_ticks[1], 0);
 }
 
-// Sample the average backdrop color from the four corners
-static void sample_corners_color(SDL_Surface* s,
-                                 Uint8 *or_, Uint8 *og, Uint8 *ob) {
-    if (!s || !or_ || !og || !ob) return;
-    if (SDL_MUSTLOCK(s)) SDL_LockSurface(s);
+static void sim_runner_stop(SimRunner *r) {
+    if (r->thread) {
+        SDL_AtomicSet(&r->quit, 1);
+        SDL_SemPost(r->wake);
+        SDL_WaitThread(r->thread, NULL);
+        r->thread = NULL;
+    }
+    if (r->wake) SDL_DestroySemaphore(r->wake);
+    r->wake = NULL;
+}
 
-    Uint32 *pix = (Uint32*)s->pixels;
-    int w = s->w, h = s->h;
-    long sr=0, sg=0, sb=0;
-    SDL_PixelFormat* fmt = s->format;
-    Uint8 r,g,b,a;
+// Performance counter time of an input event, from its millisecond
+// timestamp: events wait in the queue while a frame is drawn and presented
+static Uint64 event_counter(const SDL_Event *e, Uint64 now) {
+    Uint32 age = SDL_GetTicks() - e->common.timestamp;
+    if (age > (Uint32)(SIM_MAX_FRAME * 1000)) age = (Uint32)(SIM_MAX_FRAME * 1000);
+    Uint64 back = (Uint64)age * SDL_GetPerformanceFrequency() / 1000;
+    return back < now ? now - back : now;
+}
 
-    Uint32 corners[4] = {
-        pix[0],
-        pix[w-1],
-        pix[(h-1)*w + 0],
-        pix[(h-1)*w + (w-1)]
+// ---------------------------------------------------------------------------
+// Hot reload (--hot-reload)
+//
+// A development mode: a thread watches the asset directory with inotify and,
+// when a sprite or sound effect file is written, redoes just that asset.
+// Sprites are reloaded through the sprite cache, so only the changed PNG is
+// decoded and run through make_sprite_from_bg again; the others are cache
+// hits, and the atlas page is repacked. A sound effect is decoded again with
+// Mix_LoadWAV. The result waits in a one-slot mailbox until the game loop
+// takes it between frames (hot_apply()): uploading the new atlas page or
+// swapping the chunk pointer is all the render thread does.
+//
+// Collision masks and the bird hit box stay as loaded at launch. A replaced
+// chunk may still be playing or queued, so it is only freed at exit.
+// ---------------------------------------------------------------------------
+
+#include <poll.h>
+#include <sys/inotify.h>
+
+#define HOT_SETTLE_MS 50            // let a burst of writes finish first
+
+static struct {
+    int          on;
+    int          fd;                // inotify descriptor
+    int          scale;             // sprite scale the atlas was made at
+    Uint32       event;             // wakes a paused game loop
+    SDL_Thread  *thread;
+    SDL_atomic_t quit;
+    SDL_atomic_t ready;             // a result waits for hot_apply()
+
+    // The result: a new atlas, or a new chunk for sfx[sfx]
+    char         name[SPRITE_NAME_LEN];
+    int          sfx;               // -1 for the atlas
+    int          made;              // sprites reprocessed for it
+    SDL_Surface *page;
+    SpriteAtlas  atlas;
+    Mix_Chunk   *chunk;
+    Uint64       t_event, t_ready;  // change seen, result posted
+
+    Mix_Chunk  **retired;           // replaced chunks, freed by hot_stop()
+    int          n_retired;
+} hot;
+
+// Hand the result to the game loop and wait until it has been taken;
+// returns 0 if the game is quitting
+static int hot_post(void) {
+    hot.t_ready = SDL_GetPerformanceCounter();
+    SDL_AtomicSet(&hot.ready, 1);
+    if (hot.event != (Uint32)-1) {
+        SDL_Event e;
+        SDL_zero(e);
+        e.type = hot.event;
+        SDL_PushEvent(&e);
+    }
+    while (SDL_AtomicGet(&hot.ready)) {
+        if (SDL_AtomicGet(&hot.quit)) return 0;
+        SDL_Delay(5);
+    }
+    return 1;
+}
+
+// Reload every sprite from the cache, which reprocesses the changed ones,
+// and pack a new atlas page. A sprite that fails to load (a file still
+// being written) keeps the old atlas.
+static int hot_reload_sprites(void) {
+    SDL_Surface *spr[SPR_COUNT] = {0};
+    sprite_cache_open(SPRITE_CACHE_FILE);
+    load_sprites(hot.scale, spr);
+    int ok = 1;
+    for (int i = 0; i < SPR_COUNT; i++)
+        if (!spr[i]) ok = 0;
+    hot.page = ok ? atlas_pack(spr, &hot.atlas) : NULL;
+    hot.made = sprite_cache.dirty;
+    sprite_cache_close(SPRITE_CACHE_FILE);
+    if (!hot.page) {
+        fprintf(stderr, "Warning: hot reload of %s failed, keeping the old sprites\n", hot.name);
+        return 1;
+    }
+    hot.sfx = -1;
+    return hot_post();
+}
+
+static int hot_reload_sfx(int i, const char *path) {
+    hot.chunk = Mix_LoadWAV(path);
+    if (!hot.chunk) {
+        fprintf(stderr, "Warning: hot reload of %s failed: %s\n", path, Mix_GetError());
+        return 1;
+    }
+    SDL_strlcpy(hot.name, path, sizeof(hot.name));
+    hot.sfx = i;
+    return hot_post();
+}
+
+static int hot_thread_main(void *unused) {
+    (void)unused;
+    _Alignas(struct inotify_event) char buf[4096];
+    while (!SDL_AtomicGet(&hot.quit)) {
+        struct pollfd pfd = { hot.fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        hot.t_event = SDL_GetPerformanceCounter();
+        SDL_Delay(HOT_SETTLE_MS);
+
+        // Which assets the files written belong to
+        Uint32 sprites = 0;
+        const char *sounds[SFX_COUNT] = { 0 };
+        ssize_t n;
+        while ((n = read(hot.fd, buf, sizeof(buf))) > 0) {
+            for (char *p = buf; p < buf + n; ) {
+                const struct inotify_event *ev = (const struct inotify_event*)p;
+                p += sizeof(*ev) + ev->len;
+                if (!ev->len) continue;
+                for (int i = 0; i < SPR_COUNT; i++)
+                    if (strcmp(ev->name, SPRITES[i].file) == 0) {
+                        if (!sprites) SDL_strlcpy(hot.name, SPRITES[i].file, sizeof(hot.name));
+                        sprites |= 1u << i;
+                    }
+                for (int i = 0; i < SFX_COUNT; i++)
+                    for (int k = 0; k < 2; k++)
+                        if (strcmp(ev->name, SFX_FILES[i][k]) == 0) sounds[i] = SFX_FILES[i][k];
+            }
+        }
+
+        if (sprites && !hot_reload_sprites()) break;
+        for (int i = 0; i < SFX_COUNT; i++)
+            if (sounds[i] && !hot_reload_sfx(i, sounds[i])) break;
+    }
+    return 0;
+}
+
+// Watch the current directory; `scale` is the sprite scale of the atlas
+static void hot_start(int scale) {
+    SDL_zero(hot);
+    hot.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (hot.fd < 0 || inotify_add_watch(hot.fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "Warning: hot reload off: %s\n", strerror(errno));
+        if (hot.fd >= 0) close(hot.fd);
+        return;
+    }
+    hot.scale  = scale;
+    hot.event  = SDL_RegisterEvents(1);
+    hot.thread = SDL_CreateThread(hot_thread_main, "aeroboo-hot", NULL);
+    if (!hot.thread) {
+        fprintf(stderr, "Warning: hot reload off: %s\n", SDL_GetError());
+        close(hot.fd);
+        return;
+    }
+    hot.on = 1;
+    printf("hot-reload: watching sprites and sound effects for changes\n");
+    fflush(stdout);
+}
+
+// Between frames: swap in a finished reload and log how long it took;
+// returns 1 if something changed
+static int hot_apply(SDL_Renderer *ren, GameAssets *as) {
+    if (!hot.on || !SDL_AtomicGet(&hot.ready)) return 0;
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    if (hot.sfx < 0) {
+        SpriteAtlas at = hot.atlas;
+        if (atlas_upload(ren, hot.page, &at)) {
+            SDL_ScaleMode mode;
+            if (SDL_GetTextureScaleMode(as->atlas.tex, &mode) == 0)
+                SDL_SetTextureScaleMode(at.tex, mode);
+            SDL_DestroyTexture(as->atlas.tex);
+            as->atlas = at;
+        }
+        SDL_FreeSurface(hot.page);
+        hot.page = NULL;
+    } else {
+        Mix_Chunk **r = (Mix_Chunk**)realloc(hot.retired, sizeof(*r) * (size_t)(hot.n_retired + 1));
+        if (r) {
+            hot.retired = r;
+            r[hot.n_retired++] = (Mix_Chunk*)SDL_AtomicSetPtr((void**)&as->sfx[hot.sfx], hot.chunk);
+        } else {
+            Mix_FreeChunk(hot.chunk);       // keep the old one rather than leak it
+        }
+        hot.chunk = NULL;
+    }
+
+    double f = (double)SDL_GetPerformanceFrequency();
+    Uint64 t = SDL_GetPerformanceCounter();
+    if (hot.sfx < 0)
+        printf("hot-reload: %s, %d sprite%s reprocessed, atlas", hot.name, hot.made,
+               hot.made == 1 ? "" : "s");
+    else
+        printf("hot-reload: %s decoded,", hot.name);
+    printf(" swapped in %.1f ms after the change (%.1f ms loading, %.1f ms between frames)\n",
+           (t - hot.t_event) * 1000.0 / f, (hot.t_ready - hot.t_event) * 1000.0 / f,
+           (t - t0) * 1000.0 / f);
+    fflush(stdout);
+    SDL_AtomicSet(&hot.ready, 0);
+    return 1;
+}
+
+// Stop watching; after the simulation and the audio hooks have stopped, so
+// no replaced chunk is still in use
+static void hot_stop(void) {
+    if (!hot.on) return;
+    SDL_AtomicSet(&hot.quit, 1);
+    SDL_WaitThread(hot.thread, NULL);
+    close(hot.fd);
+    if (hot.page)  SDL_FreeSurface(hot.page);
+    if (hot.chunk) Mix_FreeChunk(hot.chunk);
+    for (int i = 0; i < hot.n_retired; i++) Mix_FreeChunk(hot.retired[i]);
+    free(hot.retired);
+    SDL_zero(hot);
+}
+
+// ---------------------------------------------------------------------------
+// Benchmarks (run with --bench-<name>; no window or audio device needed)
+//
+// Besides the table on stdout, --bench-out FILE (given before the
+// benchmark) appends every measurement to FILE as one JSON object per line,
+// for tracking results across commits:
+//   {"bench":"sim","case":"step","value":812.4,"unit":"ns/step"}
+// ---------------------------------------------------------------------------
+
+#include <stdarg.h>
+
+static FILE *bench_out;
+
+static double bench_seconds(Uint64 t0, Uint64 t1) {
+    return (double)(t1 - t0) / (double)SDL_GetPerformanceFrequency();
+}
+
+// Append one measurement to the --bench-out file; `fmt` names the case
+static void bench_record(const char *bench, const char *unit, double value,
+                         const char *fmt, ...) {
+    if (!bench_out) return;
+    char name[64];
+    va_list ap;
+    va_start(ap, fmt);
+    SDL_vsnprintf(name, sizeof(name), fmt, ap);
+    va_end(ap);
+    fprintf(bench_out, "{\"bench\":\"%s\",\"case\":\"%s\",\"value\":%.6g,\"unit\":\"%s\"}\n",
+            bench, name, value, unit);
+}
+
+// Pixels per second of each backdrop-removal path on one image, checked
+// byte for byte against the original float loop
+static int bench_desblend(const char *path) {
+    SDL_Surface *orig = IMG_Load(path);
+    if (!orig) {
+        fprintf(stderr, "IMG_Load('%s'): %s\n", path, IMG_GetError());
+        return 1;
+    }
+    SDL_Surface *src  = convert_to_rgba32(orig);
+    SDL_FreeSurface(orig);
+    SDL_Surface *ref  = src ? convert_to_rgba32(src) : NULL;
+    SDL_Surface *work = src ? convert_to_rgba32(src) : NULL;
+    if (!src || !ref || !work) {
+        fprintf(stderr, "bench: out of memory\n");
+        return 1;
+    }
+
+    Uint8 bg_r, bg_g, bg_b;
+    sample_corners_color(src, &bg_r, &bg_g, &bg_b);
+    make_sprite_from_bg_ref(ref, bg_r, bg_g, bg_b, DESBLEND_LOW, DESBLEND_HIGH);
+
+    static const struct { const char *name; int isa, threaded; } paths[] = {
+        { "float-ref",   -1,              0 },
+        { "scalar",      ISA_SCALAR, 0 },
+        { "sse2",        ISA_SSE2,   0 },
+        { "avx2",        ISA_AVX2,   0 },
+        { "scalar+pool", ISA_SCALAR, 1 },
+        { "sse2+pool",   ISA_SSE2,   1 },
+        { "avx2+pool",   ISA_AVX2,   1 },
     };
-    for(int i=0; i<4; i++){
-        SDL_GetRGBA(corners[i], fmt, &r, &g, &b, &a);
-        sr += r; sg += g; sb += b;
+    size_t bytes = (size_t)src->pitch * src->h;
+    double pixels = (double)src->w * src->h;
+    double base = 0.0;
+    int failed = 0;
+
+    printf("desblend %s %dx%d, %d pool workers\n", path, src->w, src->h, pool_init());
+    printf("%-12s %10s %8s %s\n", "path", "Mpix/s", "speedup", "output");
+    for (size_t p = 0; p < SDL_arraysize(paths); p++) {
+        int isa = paths[p].isa;
+#ifdef ISA_HAVE_X86
+        if (isa == ISA_SSE2 && !SDL_HasSSE2()) continue;
+        if (isa == ISA_AVX2 && !SDL_HasAVX2()) continue;
+#else
+        if (isa == ISA_SSE2 || isa == ISA_AVX2) continue;
+#endif
+        double spent = 0.0;
+        int runs = 0, same = 1;
+        while (runs < 3 || spent < 0.5) {
+            memcpy(work->pixels, src->pixels, bytes);
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            if (isa < 0)
+                make_sprite_from_bg_ref(work, bg_r, bg_g, bg_b, DESBLEND_LOW, DESBLEND_HIGH);
+            else
+                desblend_surface(work, bg_r, bg_g, bg_b, DESBLEND_LOW, DESBLEND_HIGH,
+                                 isa, paths[p].threaded);
+            spent += bench_seconds(t0, SDL_GetPerformanceCounter());
+            runs++;
+            if (memcmp(work->pixels, ref->pixels, bytes) != 0) same = 0;
+        }
+        double mpix = pixels * runs / spent / 1e6;
+        if (base == 0.0) base = mpix;
+        printf("%-12s %10.1f %7.2fx %s\n", paths[p].name, mpix, mpix / base,
+               same ? "identical" : "MISMATCH");
+        bench_record("desblend", "Mpix/s", mpix, "%s", paths[p].name);
+        if (!same) failed = 1;
     }
 
-    if (SDL_MUSTLOCK(s)) SDL_UnlockSurface(s);
-    *or_ = (Uint8)(sr/4);
-    *og  = (Uint8)(sg/4);
-    *ob  = (Uint8)(sb/4);
-                                 }
+    SDL_FreeSurface(work);
+    SDL_FreeSurface(ref);
+    SDL_FreeSurface(src);
+    pool_shutdown();
+    return failed;
+}
 
-                                 // Automatically generate sprite alpha channel by removing backdrop
-                                 static void make_sprite_from_bg(SDL_Surface* s, int low, int high) {
-                                     if (!s) return;
-                                     if (s->format->format != SDL_PIXELFORMAT_RGBA32) return;
-                                     if (SDL_MUSTLOCK(s)) SDL_LockSurface(s);
+// Sprite loading as the asset loader does it, at `scale` times the
+// on-screen size: every PNG decoded, cleaned and resampled, then the same
+// sprites found in a sprite cache, then packing them into the atlas. The
+// cache is a scratch file next to the images, removed afterwards.
+#define BENCH_LOAD_CACHE "aeroboo-bench.cache"
 
-                                     Uint8 *B = (Uint8*)s->pixels;
-                                     int w = s->w, h = s->h;
-                                     Uint8 bg_r, bg_g, bg_b;
-                                     sample_corners_color(s, &bg_r, &bg_g, &bg_b);
+static int bench_load(int scale) {
+    IMG_Init(IMG_INIT_PNG);
+    static const char *const paths[] = { "decode", "cache" };
+    double base = 0.0, pack = 0.0;
+    int packs = 0, written = 0, failed = 0;
 
-                                     for(int i=0, tot=w*h; i<tot; i++){
-                                         Uint8 r = B[4*i+0], g = B[4*i+1], b = B[4*i+2];
-                                         int dr = abs(r - bg_r),
-                                         dg = abs(g - bg_g),
-                                         db = abs(b - bg_b);
-                                         int d = dr>dg?dr:dg; d = db>d?db:d;
-                                         float a = (d <= low
-                                         ? 0.0f
-                                         : (d >= high
-                                         ? 1.0f
-                                         : (float)(d-low)/(high-low)));
-                                         Uint8 outA = clamp_u8((int)(255*a + .5f));
-                                         Uint8 outR, outG, outB;
-                                         if (a <= 0.0f) {
-                                             outR = bg_r; outG = bg_g; outB = bg_b;
-                                         } else {
-                                             outR = clamp_u8((int)(((r - (1.f - a)*bg_r)/a) + .5f));
-                                             outG = clamp_u8((int)(((g - (1.f - a)*bg_g)/a) + .5f));
-                                             outB = clamp_u8((int)(((b - (1.f - a)*bg_b)/a) + .5f));
-                                         }
-                                         Uint32 p = SDL_MapRGBA(s->format, outR, outG, outB, outA);
-                                         ((Uint32*)B)[i] = p;
-                                     }
+    printf("load %d sprites at %dx, %d pool workers\n", SPR_COUNT, scale, pool_init());
+    printf("%-12s %10s %8s\n", "path", "ms/load", "speedup");
+    for (int c = 0; c < 2 && !failed; c++) {
+        double spent = 0.0;
+        int runs = 0;
+        while (runs < 3 || spent < 0.5) {
+            SDL_Surface *spr[SPR_COUNT] = {0};
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            if (c) sprite_cache_open(BENCH_LOAD_CACHE);
+            load_sprites(scale, spr);
+            spent += bench_seconds(t0, SDL_GetPerformanceCounter());
+            runs++;
+            for (int i = 0; i < SPR_COUNT; i++)
+                if (!spr[i]) failed = 1;
+            if (!failed && c) {
+                SpriteAtlas at;
+                Uint64 t1 = SDL_GetPerformanceCounter();
+                SDL_Surface *page = atlas_pack(spr, &at);
+                pack += bench_seconds(t1, SDL_GetPerformanceCounter());
+                packs++;
+                if (page) SDL_FreeSurface(page);
+            }
+            if (!failed && !c && !written) written = sprite_cache_write(BENCH_LOAD_CACHE);
+            sprite_cache.dirty = 0;
+            sprite_cache_close(BENCH_LOAD_CACHE);
+            if (failed || !written) {
+                failed = 1;
+                break;
+            }
+        }
+        if (failed) break;
+        double ms = spent * 1e3 / runs;
+        if (base == 0.0) base = ms;
+        printf("%-12s %10.3f %7.2fx\n", paths[c], ms, base / ms);
+        bench_record("load", "ms/load", ms, "%s", paths[c]);
+    }
+    if (packs) {
+        printf("%-12s %10.3f\n", "atlas pack", pack * 1e3 / packs);
+        bench_record("load", "ms/load", pack * 1e3 / packs, "atlas-pack");
+    }
+    if (failed) fprintf(stderr, "bench-load: could not load or cache every sprite\n");
 
-                                     if (SDL_MUSTLOCK(s)) SDL_UnlockSurface(s);
-                                 }
+    // Baking another scale into the file must keep this scale's entries:
+    // loading again afterwards reprocesses nothing
+    if (!failed) {
+        int other = scale == 1 ? 2 : 1, kept = 0;
+        if (sprite_cache_bake(BENCH_LOAD_CACHE, other, 0) == 0) {
+            SDL_Surface *spr[SPR_COUNT] = {0};
+            sprite_cache_open(BENCH_LOAD_CACHE);
+            load_sprites(scale, spr);
+            kept = sprite_cache.dirty == 0;
+            for (int i = 0; i < SPR_COUNT; i++)
+                if (!spr[i]) kept = 0;
+            sprite_cache.dirty = 0;
+            sprite_cache_close(BENCH_LOAD_CACHE);
+        }
+        printf("bake at %dx keeps %dx entries: %s\n", other, scale, kept ? "yes" : "NO");
+        if (!kept) failed = 1;
+    }
 
-                                 // Load a texture from file and process its sprite backdrop removal
-                                 static SDL_Texture* load_and_process_texture(SDL_Renderer* ren,
-                                                                              const char* path,
-                                                                              SDL_Surface **out_surf) {
-                                     *out_surf = NULL;
-                                     SDL_Surface* orig = IMG_Load(path);
-                                     if (!orig) {
-                                         fprintf(stderr, "IMG_Load('%s'): %s\n", path, IMG_GetError());
-                                         return NULL;
-                                     }
-                                     SDL_Surface* s32 = convert_to_rgba32(orig);
-                                     SDL_FreeSurface(orig);
-                                     if (!s32) return NULL;
+    remove(BENCH_LOAD_CACHE);
+    remove(BENCH_LOAD_CACHE ".lock");
+    pool_shutdown();
+    IMG_Quit();
+    return failed;
+}
 
-                                     SDL_Surface* sample = SDL_ConvertSurfaceFormat(s32,
-                                                                                    SDL_PIXELFORMAT_RGBA32, 0);
-                                     *out_surf = sample ? sample : s32;
+// Cost of one SDL_GetPerformanceCounter() pair, taken off the per-phase
+// timings below
+static double bench_counter_overhead(void) {
+    Uint64 sum = 0;
+    for (int i = 0; i < 100000; i++) {
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        sum += SDL_GetPerformanceCounter() - t0;
+    }
+    return (double)sum / 100000;
+}
 
-                                     make_sprite_from_bg(s32, DESBLEND_LOW, DESBLEND_HIGH);
+// Uniform 0..1 from a small LCG, so stress runs repeat exactly
+static float bench_rand(Uint32 *seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return (float)(*seed >> 8) / (1u << 24);
+}
 
-                                     SDL_Texture* tex = SDL_CreateTextureFromSurface(ren, s32);
-                                     SDL_FreeSurface(s32);
-                                     if (!tex) {
-                                         fprintf(stderr, "SDL_CreateTexture: %s\n", SDL_GetError());
-                                         if (sample) SDL_FreeSurface(sample);
-                                         return NULL;
-                                     }
-                                     SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
-                                     return tex;
-                                                                              }
+// Replace birds and shells lost in a stress run: birds enter from the
+// right at a random height, shells leave from a random point on the ground
+static void bench_top_up(SimState *s, int birds, int shots, Uint32 *seed) {
+    while (s->birds.n < birds)
+        sim_spawn_bird(s, WIN_W + 10, bench_rand(seed) * (WIN_H / 2), 180.f);
+    while (s->shots.n < shots)
+        sim_spawn_shot(s, bench_rand(seed) * WIN_W, WIN_H);
+}
 
-                                                                              // Check intersection of two floating-point rectangles
-                                                                              static int rects_intersectf(float ax, float ay, float aw, float ah,
-                                                                                                          float bx, float by, float bw, float bh) {
-                                                                                  if (ax + aw <= bx) return 0;
-                                                                                  if (bx + bw <= ax) return 0;
-                                                                                  if (ay + ah <= by) return 0;
-                                                                                  if (by + bh <= ay) return 0;
-                                                                                  return 1;
-                                                                                                          }
+// Run `steps` steps from `init` with the given clicks, keeping `birds`
+// birds and `shots` shells alive if non-zero (stress runs). Prints the
+// step rate and each phase's share, recorded under `bench`; returns the
+// final state hash, or 0 if repeated runs disagreed.
+static Uint64 bench_sim_run(const char *bench, const SimState *init, const Uint32 *input,
+                            long steps, int birds, int shots, Uint64 *run_hash) {
+    SimState *s = (SimState*)malloc(sizeof *s);
+    if (!s) {
+        fprintf(stderr, "bench: out of memory\n");
+        return 0;
+    }
 
-                                                                                                          // Display the splash screen in an isolated SDL context, then quit it
-                                                                                                          static void show_splash(void) {
-                                                                                                              if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
-                                                                                                                  fprintf(stderr, "SDL_Init(splash): %s\n", SDL_GetError());
-                                                                                                                  return;
-                                                                                                              }
-                                                                                                              if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
-                                                                                                                  fprintf(stderr, "IMG_Init(splash): %s\n", IMG_GetError());
-                                                                                                                  SDL_Quit();
-                                                                                                                  return;
-                                                                                                              }
+    // Reference run: hashes, totals, live entities and per-phase time.
+    // Stress runs spawn replacements at the edges, from a fixed sequence
+    // so every run is the same.
+    double phase_ticks[SIM_PHASE_COUNT] = { 0 }, overhead = bench_counter_overhead();
+    double live_birds = 0, live_shots = 0, live_booms = 0;
+    Uint32 seed = 1;
+    *s = *init;
+    *run_hash = sim_hash(s);
+    for (long k = 0; k < steps; k++) {
+        bench_top_up(s, birds, shots, &seed);
+        for (int p = 0; p < SIM_PHASE_COUNT; p++) {
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            SIM_PHASES[p].fn(s, input[k]);
+            phase_ticks[p] += SDL_GetPerformanceCounter() - t0 - overhead;
+        }
+        live_birds += s->birds.n;
+        live_shots += s->shots.n;
+        live_booms += s->booms.n;
+        Uint64 pair[2] = { *run_hash, sim_hash(s) };
+        *run_hash = hash_bytes(pair, sizeof pair);
+    }
+    Uint64 final_hash = sim_hash(s);
+    long fired = s->fired, kills = s->kills;
 
-                                                                                                              SDL_Window   *sw = SDL_CreateWindow("Aeroboo",
-                                                                                                                                                  SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                                                                                                                                                  WIN_W, WIN_H, 0);
-                                                                                                              SDL_Renderer *sr = SDL_CreateRenderer(sw, -1,
-                                                                                                                                                    SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-                                                                                                              if (sw && sr) {
-                                                                                                                  SDL_Texture *st = IMG_LoadTexture(sr, SPLASH_IMG);
-                                                                                                                  if (st) {
-                                                                                                                      Uint32 start = SDL_GetTicks();
-                                                                                                                      while (SDL_GetTicks() - start < SPLASH_DURATION_MS) {
-                                                                                                                          SDL_Event e;
-                                                                                                                          while (SDL_PollEvent(&e))
-                                                                                                                              if (e.type == SDL_QUIT) {
-                                                                                                                                  start = SDL_GetTicks() + SPLASH_DURATION_MS;
-                                                                                                                                  break;
-                                                                                                                              }
-                                                                                                                              SDL_RenderClear(sr);
-                                                                                                                          SDL_RenderCopy(sr, st, NULL, NULL);
-                                                                                                                          SDL_RenderPresent(sr);
-                                                                                                                          SDL_Delay(16);
-                                                                                                                      }
-                                                                                                                      SDL_DestroyTexture(st);
-                                                                                                                  }
-                                                                                                              }
+    // Whole steps, as the game loop runs them
+    double spent = 0.0;
+    int runs = 0;
+    while (runs < 3 || spent < 0.5) {
+        *s = *init;
+        seed = 1;
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        for (long k = 0; k < steps; k++) {
+            bench_top_up(s, birds, shots, &seed);
+            sim_step(s, input[k]);
+        }
+        spent += bench_seconds(t0, SDL_GetPerformanceCounter());
+        runs++;
+        if (sim_hash(s) != final_hash) {
+            fprintf(stderr, "bench-sim: run %d diverged\n", runs);
+            free(s);
+            return 0;
+        }
+    }
+    free(s);
 
-                                                                                                              if (sr) SDL_DestroyRenderer(sr);
-                                                                                                              if (sw) SDL_DestroyWindow(sw);
-                                                                                                              IMG_Quit();
-                                                                                                              SDL_Quit();
-                                                                                                          }
+    double step_ns = spent * 1e9 / ((double)steps * runs);
+    double live = (live_birds + live_shots + live_booms) / steps;
+    double freq = (double)SDL_GetPerformanceFrequency(), total = 0.0;
+    for (int p = 0; p < SIM_PHASE_COUNT; p++) {
+        if (phase_ticks[p] < 0) phase_ticks[p] = 0;
+        total += phase_ticks[p];
+    }
+    printf("%ld steps, %ld shots fired, %ld birds hit; on average %.0f birds, "
+           "%.0f shells, %.0f explosions alive\n", steps, fired, kills,
+           live_birds / steps, live_shots / steps, live_booms / steps);
+    printf("%-12s %10.1f ns/step %10.2f ns/entity %12.0f sim s/wall s\n", "step",
+           step_ns, live > 0 ? step_ns / live : 0.0, SIM_DT * 1e9 / step_ns);
+    bench_record(bench, "ns/step", step_ns, "step");
+    for (int p = 0; p < SIM_PHASE_COUNT; p++) {
+        printf("  %-10s %10.1f ns/step %9.0f%% of step\n", SIM_PHASES[p].name,
+               phase_ticks[p] * 1e9 / freq / steps,
+               total > 0 ? phase_ticks[p] * 100.0 / total : 0.0);
+        bench_record(bench, "ns/step", phase_ticks[p] * 1e9 / freq / steps,
+                     "%s", SIM_PHASES[p].name);
+    }
+    return final_hash;
+}
+
+// Game logic with no window or audio: simulated seconds per wall second,
+// the cost of each update phase, and hashes of the final state and of the
+// whole run for comparing logic changes. `clicks` lists fire times in
+// simulated seconds ("1.5,3,4.25"); without it there is a click every
+// 0.9 s. Sprite heights are fixed here so hashes do not depend on images.
+#define BENCH_SIM_MAX_CLICKS 1024
+
+static int bench_sim(double seconds, const char *clicks, int level_birds) {
+    static double at[BENCH_SIM_MAX_CLICKS];
+    int n_at = 0;
+    if (clicks) {
+        const char *p = clicks;
+        while (*p && n_at < BENCH_SIM_MAX_CLICKS) {
+            char *end;
+            double t = strtod(p, &end);
+            if (end == p) {
+                fprintf(stderr, "bench-sim: bad click list '%s'\n", clicks);
+                return 1;
+            }
+            at[n_at++] = t;
+            p = (*end == ',') ? end + 1 : end;
+        }
+    } else {
+        for (double t = 0.9; t < seconds && n_at < BENCH_SIM_MAX_CLICKS; t += 0.9)
+            at[n_at++] = t;
+    }
+    long steps = (long)(seconds * SIM_HZ + 0.5);
+    if (steps <= 0) {
+        fprintf(stderr, "bench-sim: nothing to run\n");
+        return 1;
+    }
+
+    // Clicks land on the first step at or after their time
+    Uint32 *input = (Uint32*)calloc((size_t)steps, sizeof *input);
+    SimState *init = (SimState*)malloc(sizeof *init);
+    if (!input || !init) {
+        fprintf(stderr, "bench: out of memory\n");
+        free(input);
+        free(init);
+        return 1;
+    }
+    for (int i = 0; i < n_at; i++) {
+        long k = (long)ceil(at[i] * SIM_HZ);
+        if (k >= 0 && k < steps) input[k] |= SIM_IN_FIRE;
+    }
+    sim_init(init, BIRD_DRAW_W, BIRD_DRAW_W * 3 / 4, CANNON_DRAW_W, CANNON_DRAW_W,
+             level_birds);
+
+    printf("sim %.1f s at %d Hz, %d birds per wave, %d clicks\n",
+           seconds, SIM_HZ, level_birds, n_at);
+    Uint64 run_hash = 0, final_hash = bench_sim_run("sim", init, input, steps, 0, 0, &run_hash);
+    if (final_hash) {
+        printf("final state %016llx\n", (unsigned long long)final_hash);
+        printf("whole run   %016llx\n", (unsigned long long)run_hash);
+    }
+    free(input);
+    free(init);
+    return final_hash ? 0 : 1;
+}
+
+// Stress run: `n` birds and `n` shells (up to the pool sizes) kept alive
+// for `seconds` of simulated time, reporting update cost per entity
+static int bench_entities(int n, double seconds) {
+    if (n < 1) n = 1;
+    int birds = n < SIM_MAX_BIRDS ? n : SIM_MAX_BIRDS;
+    int shots = n < SIM_MAX_SHOTS ? n : SIM_MAX_SHOTS;
+    long steps = (long)(seconds * SIM_HZ + 0.5);
+    Uint32 *input = (Uint32*)calloc((size_t)(steps > 0 ? steps : 1), sizeof *input);
+    SimState *init = (SimState*)malloc(sizeof *init);
+    if (!input || !init || steps <= 0) {
+        fprintf(stderr, "bench: out of memory\n");
+        free(input);
+        free(init);
+        return 1;
+    }
+
+    // Start with the flock spread across the window instead of queued
+    // off screen, so collisions begin right away
+    sim_init(init, BIRD_DRAW_W, BIRD_DRAW_W * 3 / 4, CANNON_DRAW_W, CANNON_DRAW_W, 0);
+    Uint32 seed = 7;
+    for (int i = 0; i < birds; i++)
+        sim_spawn_bird(init, (float)i * (WIN_W + init->bw) / birds - init->bw,
+                       bench_rand(&seed) * (WIN_H / 2), 180.f);
+
+    printf("entities %d birds + %d shells, %.1f s at %d Hz\n",
+           birds, shots, seconds, SIM_HZ);
+    Uint64 run_hash = 0, final_hash = bench_sim_run("entities", init, input, steps, birds, shots,
+                                                 &run_hash);
+    free(input);
+    free(init);
+    return final_hash ? 0 : 1;
+}
+
+// Collision phase alone, brute force against the grid, with half the
+// entities birds and half shells scattered over the field. Both must
+// leave the same state behind.
+#define BENCH_COLLIDE_STEPS 30
+
+static int bench_collide(void) {
+    static const int sizes[] = { 10, 100, 1000, 10000 };
+    static const char *const modes[] = { [SIM_COLLIDE_GRID] = "grid",
+                                         [SIM_COLLIDE_BRUTE] = "brute" };
+    SimState *init = (SimState*)malloc(sizeof *init);
+    SimState *s    = (SimState*)malloc(sizeof *s);
+    if (!init || !s) {
+        fprintf(stderr, "bench: out of memory\n");
+        free(init);
+        free(s);
+        return 1;
+    }
+
+    int failed = 0;
+    printf("collide %d steps per run\n", BENCH_COLLIDE_STEPS);
+    printf("%-9s %-6s %12s %8s %8s %s\n", "entities", "phase", "us/step", "speedup",
+           "hits", "state");
+    for (size_t n = 0; n < SDL_arraysize(sizes); n++) {
+        int birds = sizes[n] / 2, shots = sizes[n] - birds;
+        Uint32 seed = 11;
+        sim_init(init, BIRD_DRAW_W, BIRD_DRAW_W * 3 / 4, CANNON_DRAW_W, CANNON_DRAW_W, 0);
+        for (int i = 0; i < birds; i++)
+            sim_spawn_bird(init, bench_rand(&seed) * (WIN_W + init->bw) - init->bw,
+                           bench_rand(&seed) * (WIN_H / 2), 180.f);
+        for (int j = 0; j < shots; j++)
+            sim_spawn_shot(init, bench_rand(&seed) * WIN_W, bench_rand(&seed) * WIN_H);
+
+        Uint64 hash[2] = { 0, 0 };
+        double us[2] = { 0, 0 };
+        for (int m = SIM_COLLIDE_BRUTE; m >= SIM_COLLIDE_GRID; m--) {
+            double spent = 0.0;
+            int runs = 0;
+            while (runs < 1 || spent < 0.2) {
+                *s = *init;
+                s->collide = m;
+                seed = 1;
+                for (int k = 0; k < BENCH_COLLIDE_STEPS; k++) {
+                    bench_top_up(s, birds, shots, &seed);
+                    for (int p = 0; p < SIM_PHASE_COUNT; p++) {
+                        if (SIM_PHASES[p].fn != sim_phase_hits) {
+                            SIM_PHASES[p].fn(s, 0);
+                            continue;
+                        }
+                        Uint64 t0 = SDL_GetPerformanceCounter();
+                        sim_phase_hits(s, 0);
+                        spent += bench_seconds(t0, SDL_GetPerformanceCounter());
+                    }
+                }
+                runs++;
+            }
+            hash[m] = sim_hash(s);
+            us[m]   = spent * 1e6 / ((double)BENCH_COLLIDE_STEPS * runs);
+            int same = m == SIM_COLLIDE_BRUTE || hash[m] == hash[SIM_COLLIDE_BRUTE];
+            printf("%-9d %-6s %12.2f %7.2fx %8ld %s\n", sizes[n], modes[m], us[m],
+                   us[SIM_COLLIDE_BRUTE] / us[m], s->kills,
+                   m == SIM_COLLIDE_BRUTE ? "" : same ? "identical" : "MISMATCH");
+            bench_record("collide", "us/step", us[m], "%s/%d", modes[m], sizes[n]);
+            if (!same) failed = 1;
+        }
+    }
+    free(init);
+    free(s);
+    return failed;
+}
+
+// Narrow phase on one sprite: box test alone against box plus collision
+// mask, for shells scattered over and around the bird. Reports the cost
+// of each and how many box hits were only sky.
+static int bench_mask(const char *path) {
+    SDL_Surface *orig = IMG_Load(path);
+    if (!orig) {
+        fprintf(stderr, "IMG_Load('%s'): %s\n", path, IMG_GetError());
+        return 1;
+    }
+    SDL_Surface *s32 = convert_to_rgba32(orig);
+    SDL_FreeSurface(orig);
+    if (!s32) return 1;
+    make_sprite_from_bg(s32, DESBLEND_LOW, DESBLEND_HIGH);
+    int bw = BIRD_DRAW_W, bh = (int)(s32->h * ((float)BIRD_DRAW_W / (float)s32->w) + .5f);
+    SDL_Surface *spr = resample_surface(s32, bw, bh);
+    SDL_FreeSurface(s32);
+
+    CollisionMask mask;
+    SimState *s = (SimState*)malloc(sizeof *s);
+    if (!spr || !s || !mask_build(spr, bw, bh, &mask)) {
+        fprintf(stderr, "bench: out of memory\n");
+        if (spr) SDL_FreeSurface(spr);
+        free(s);
+        return 1;
+    }
+    SDL_FreeSurface(spr);
+
+    // One bird mid-flight and a full pool of shells in flight around it
+    Uint32 seed = 5;
+    sim_init(s, bw, bh, CANNON_DRAW_W, CANNON_DRAW_W, 0);
+    sim_spawn_bird(s, 300.f, 100.f, 180.f);
+    s->birds.px[0] = 300.f + 1.5f;
+    while (sim_spawn_shot(s, 300.f - s->pw + bench_rand(&seed) * (bw + s->pw),
+                          100.f - s->ph + bench_rand(&seed) * (bh + s->ph)))
+        s->shots.py[s->shots.n - 1] = s->shots.y[s->shots.n - 1] + 5.f;
+
+    int set = 0;
+    for (int y = 0; y < mask.h; y++)
+        for (int x = 0; x < mask.w; x++)
+            set += (int)(mask.bits[(size_t)y * mask.words + (x >> 6)] >> (x & 63)) & 1;
+    printf("mask %s %dx%d, %d words, %.0f%% of the box opaque; %d shells\n",
+           path, bw, bh, mask.words * mask.h, set * 100.0 / (bw * bh), s->shots.n);
+    printf("%-10s %10s %8s\n", "test", "ns/test", "hits");
+
+    int hits[2] = { 0, 0 };
+    for (int m = 0; m < 2; m++) {
+        s->bird_mask[0] = s->bird_mask[1] = m ? &mask : NULL;
+        double spent = 0.0;
+        int runs = 0;
+        while (runs < 3 || spent < 0.3) {
+            int n = 0;
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            for (int j = 0; j < s->shots.n; j++)
+                n += sim_shot_hits_bird(s, j, 0);
+            spent += bench_seconds(t0, SDL_GetPerformanceCounter());
+            runs++;
+            hits[m] = n;
+        }
+        double ns = spent * 1e9 / ((double)s->shots.n * runs);
+        printf("%-10s %10.2f %8d\n", m ? "box+mask" : "box", ns, hits[m]);
+        bench_record("mask", "ns/test", ns, "%s", m ? "box+mask" : "box");
+    }
+    printf("%.0f%% of box hits were sky\n",
+           hits[0] ? (hits[0] - hits[1]) * 100.0 / hits[0] : 0.0);
+
+    mask_free(&mask);
+    free(s);
+    return 0;
+}
+
+// CPU side of the sprite batch: queue and flush frames of n sprites spread
+// over three layers and two textures, submitting nothing. Prints the time
+// per sprite and the calls and vertices each frame would send.
+static int bench_batch(void) {
+    static const int sizes[] = { 10, 100, 1000, 10000, 50000 };
+    SpriteAtlas at;
+    SDL_zero(at);
+    at.w = at.h = ATLAS_MIN_W;
+    at.white = (SDL_Rect){ 0, 0, ATLAS_WHITE, ATLAS_WHITE };
+    at.tex = (SDL_Texture*)&at;             // never dereferenced without a renderer
+    SpriteAtlas other = at;
+    other.tex = (SDL_Texture*)&other;
+    const SDL_Rect src = { 8, 8, BIRD_DRAW_W, BIRD_DRAW_W };
+    const SDL_Color tint = { 220, 200, 60, 255 };
+
+    SpriteBatch b;
+    SDL_zero(b);
+    printf("batch\n%-9s %10s %8s %10s\n", "sprites", "ns/sprite", "calls", "vertices");
+    for (size_t n = 0; n < SDL_arraysize(sizes); n++) {
+        double spent = 0.0;
+        int frames = 0;
+        while (frames < 3 || spent < 0.2) {
+            Uint32 seed = 3;
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            sprite_batch_begin(&b, NULL);
+            for (int i = 0; i < sizes[n]; i++) {
+                SDL_FRect dst = { bench_rand(&seed) * WIN_W, bench_rand(&seed) * WIN_H,
+                                  BIRD_DRAW_W, BIRD_DRAW_W };
+                if (i % 8 == 7)
+                    sprite_batch_sprite(&b, &other, LAYER_OVERLAY, &src, &dst);
+                else if (i % 3 == 0)
+                    sprite_batch_fill(&b, &at, LAYER_SHOTS, &dst, tint);
+                else
+                    sprite_batch_sprite(&b, &at, LAYER_WORLD, &src, &dst);
+            }
+            sprite_batch_flush(&b);
+            spent += bench_seconds(t0, SDL_GetPerformanceCounter());
+            frames++;
+        }
+        double ns = spent * 1e9 / ((double)sizes[n] * frames);
+        printf("%-9d %10.2f %8d %10d\n", sizes[n], ns, b.draw_calls, b.vertices);
+        bench_record("batch", "ns/sprite", ns, "%d", sizes[n]);
+    }
+    sprite_batch_free(&b);
+    return 0;
+}
+
+// Particle kernels on pools of sparks that outlive the run, each path
+// checked bit for bit against the scalar one, then the time to queue them
+// all into the sprite batch as a frame does. `n` picks one pool size.
+static int bench_particles(int n) {
+    static const struct { const char *name; int isa; } paths[] = {
+        { "scalar", ISA_SCALAR },
+        { "sse2",   ISA_SSE2   },
+        { "avx2",   ISA_AVX2   },
+    };
+    int sizes[] = { 1000, 10000, 30000, SIM_MAX_PARTS }, nsizes = SDL_arraysize(sizes);
+    if (n > 0) {
+        sizes[0] = n < SIM_MAX_PARTS ? n : SIM_MAX_PARTS;
+        nsizes = 1;
+    }
+    SimState *s   = (SimState*)malloc(sizeof *s);
+    PartPool *ref = (PartPool*)malloc(sizeof *ref);
+    PartPool *p   = (PartPool*)malloc(sizeof *p);
+    if (!s || !ref || !p) {
+        fprintf(stderr, "bench: out of memory\n");
+        free(s);
+        free(ref);
+        free(p);
+        return 1;
+    }
+    SpriteAtlas at;
+    SDL_zero(at);
+    at.w = at.h = ATLAS_MIN_W;
+    at.white = (SDL_Rect){ 0, 0, ATLAS_WHITE, ATLAS_WHITE };
+    SpriteBatch b;
+    SDL_zero(b);
+
+    int failed = 0;
+    printf("particles, updates per ms\n%-9s", "sparks");
+    for (size_t k = 0; k < SDL_arraysize(paths); k++) printf(" %10s", paths[k].name);
+    printf(" %14s\n", "queue ns/spark");
+    for (int z = 0; z < nsizes; z++) {
+        PartPool *init = &s->parts;
+        Uint32 seed = 5;
+        init->n = sizes[z];
+        for (int i = 0; i < init->n; i++) {
+            init->x[i]    = bench_rand(&seed) * WIN_W;
+            init->y[i]    = bench_rand(&seed) * WIN_H;
+            init->vx[i]   = (bench_rand(&seed) - 0.5f) * 2.f * PART_SPEED;
+            init->vy[i]   = (bench_rand(&seed) - 0.5f) * 2.f * PART_SPEED;
+            init->life[i] = 1e6f;
+        }
+
+        printf("%-9d", init->n);
+        for (size_t k = 0; k < SDL_arraysize(paths); k++) {
+            int isa = paths[k].isa;
+#ifdef ISA_HAVE_X86
+            int have = isa == ISA_SCALAR || (isa == ISA_SSE2 && SDL_HasSSE2()) ||
+                       (isa == ISA_AVX2 && SDL_HasAVX2());
+#else
+            int have = isa == ISA_SCALAR;
+#endif
+            if (!have) {
+                printf(" %10s", "-");
+                continue;
+            }
+            memcpy(p, init, sizeof *p);
+            double spent = 0.0;
+            long steps = 0;
+            while (steps < 100 || spent < 0.2) {
+                Uint64 t0 = SDL_GetPerformanceCounter();
+                for (int r = 0; r < 10; r++) part_update(p, isa);
+                spent += bench_seconds(t0, SDL_GetPerformanceCounter());
+                steps += 10;
+            }
+
+            // The same steps from the same start on every path
+            memcpy(p, init, sizeof *p);
+            for (int r = 0; r < 100; r++) part_update(p, isa);
+            if (isa == ISA_SCALAR) memcpy(ref, p, sizeof *p);
+            size_t bytes = sizeof p->x[0] * p->n;
+            int same = memcmp(p->x, ref->x, bytes) == 0 && memcmp(p->y, ref->y, bytes) == 0 &&
+                       memcmp(p->vx, ref->vx, bytes) == 0 && memcmp(p->vy, ref->vy, bytes) == 0 &&
+                       memcmp(p->life, ref->life, bytes) == 0;
+            printf(" %10.0f%s", (double)p->n * steps / (spent * 1e3), same ? "" : "!");
+            bench_record("particles", "updates/ms", (double)p->n * steps / (spent * 1e3),
+                         "%s/%d", paths[k].name, init->n);
+            if (!same) failed = 1;
+        }
+
+        // Queued as in a real burst, with lives spread over PART_LIFE so the
+        // colours stay in range
+        for (int i = 0; i < init->n; i++) init->life[i] = PART_LIFE * (float)(i + 1) / init->n;
+        double spent = 0.0;
+        int frames = 0;
+        while (frames < 3 || spent < 0.2) {
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            sprite_batch_begin(&b, NULL);
+            sim_draw_particles(s, &b, &at, 0.5f, 1);
+            sprite_batch_flush(&b);
+            spent += bench_seconds(t0, SDL_GetPerformanceCounter());
+            frames++;
+        }
+        printf(" %14.2f\n", spent * 1e9 / ((double)init->n * frames));
+        bench_record("particles", "ns/spark", spent * 1e9 / ((double)init->n * frames),
+                     "queue/%d", init->n);
+    }
+    if (failed) printf("! differs from the scalar path\n");
+
+    sprite_batch_free(&b);
+    free(p);
+    free(ref);
+    free(s);
+    return failed;
+}
+
+// Whole frames of n half-transparent sprites, scaled up 2x, composited by
+// each software blend path and by SDL's own software renderer drawing the
+// same batch into a surface. The atlas page is made up here, so no images
+// are needed. Our paths must match the scalar one byte for byte.
+static int bench_soft(void) {
+    static const int sizes[] = { 10, 100, 1000 };
+    static const struct { const char *name; int isa, filter; } paths[] = {
+        { "scalar nearest",  ISA_SCALAR, SOFT_NEAREST  },
+        { "sse2 nearest",    ISA_SSE2,   SOFT_NEAREST  },
+        { "avx2 nearest",    ISA_AVX2,   SOFT_NEAREST  },
+        { "scalar bilinear", ISA_SCALAR, SOFT_BILINEAR },
+        { "sse2 bilinear",   ISA_SSE2,   SOFT_BILINEAR },
+        { "avx2 bilinear",   ISA_AVX2,   SOFT_BILINEAR },
+    };
+    SpriteAtlas at;
+    SDL_zero(at);
+    at.w = ATLAS_MIN_W;
+    at.h = 128;
+    at.white = (SDL_Rect){ 200, 8, ATLAS_WHITE, ATLAS_WHITE };
+    const SDL_Rect src = { 8, 8, 64, 48 };
+    SDL_Surface *page   = SDL_CreateRGBSurfaceWithFormat(0, at.w, at.h, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_Surface *screen = SDL_CreateRGBSurfaceWithFormat(0, WIN_W, WIN_H, 32, SDL_PIXELFORMAT_RGBA32);
+    Uint32 *ref = (Uint32*)malloc(sizeof *ref * WIN_W * WIN_H);
+    SoftTarget t;
+    SDL_zero(t);
+    if (!page || !screen || !ref || !soft_init(&t, WIN_W, WIN_H, page, SOFT_NEAREST)) {
+        fprintf(stderr, "bench: out of memory\n");
+        if (page) SDL_FreeSurface(page);
+        if (screen) SDL_FreeSurface(screen);
+        free(ref);
+        return 1;
+    }
+
+    // A disc fading out to transparent edges, and the white block
+    SDL_FillRect(page, NULL, 0);
+    SDL_FillRect(page, &at.white, 0xffffffffu);
+    for (int y = 0; y < src.h; y++) {
+        Uint8 *row = (Uint8*)page->pixels + (size_t)(src.y + y) * page->pitch + 4 * src.x;
+        for (int x = 0; x < src.w; x++) {
+            float dx = (x - src.w / 2) / (src.w / 2.f), dy = (y - src.h / 2) / (src.h / 2.f);
+            float d = sqrtf(dx * dx + dy * dy);
+            row[4*x+0] = (Uint8)(4 * x);
+            row[4*x+1] = (Uint8)(5 * y);
+            row[4*x+2] = 160;
+            row[4*x+3] = d >= 1.f ? 0 : (Uint8)(255 * (1.f - d));
+        }
+    }
+
+    // SDL's renderer draws from a texture of the same page
+    SDL_Renderer *sw  = SDL_CreateSoftwareRenderer(screen);
+    SDL_Texture  *tex = sw ? SDL_CreateTextureFromSurface(sw, page) : NULL;
+    if (tex) SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+
+    SpriteBatch b;
+    SDL_zero(b);
+    int failed = 0;
+    printf("soft %dx%d frames\n%-9s %-16s %10s %8s %s\n", WIN_W, WIN_H, "sprites", "path",
+           "ms/frame", "speedup", "output");
+    for (size_t n = 0; n < SDL_arraysize(sizes); n++) {
+        double base = 0.0;
+        for (int p = -1; p < (int)SDL_arraysize(paths); p++) {
+            const char *name = p < 0 ? "sdl software" : paths[p].name;
+            if (p < 0 && !tex) continue;
+            if (p >= 0) {
+#ifdef ISA_HAVE_X86
+                if (paths[p].isa == ISA_SSE2 && !SDL_HasSSE2()) continue;
+                if (paths[p].isa == ISA_AVX2 && !SDL_HasAVX2()) continue;
+#else
+                if (paths[p].isa != ISA_SCALAR) continue;
+#endif
+                t.isa    = paths[p].isa;
+                t.filter = paths[p].filter;
+            }
+            at.tex = p < 0 ? tex : NULL;
+            double spent = 0.0;
+            int frames = 0;
+            while (frames < 3 || spent < 0.2) {
+                Uint32 seed = 9;
+                Uint64 t0 = SDL_GetPerformanceCounter();
+                if (p < 0) {
+                    SDL_SetRenderDrawColor(sw, SKY_COLOR.r, SKY_COLOR.g, SKY_COLOR.b, 255);
+                    SDL_RenderClear(sw);
+                } else {
+                    soft_clear(&t, SKY_COLOR);
+                }
+                sprite_batch_begin(&b, p < 0 ? sw : NULL);
+                b.soft = p < 0 ? NULL : &t;
+                for (int i = 0; i < sizes[n]; i++) {
+                    SDL_FRect dst = { bench_rand(&seed) * WIN_W - 64, bench_rand(&seed) * WIN_H - 48,
+                                      2 * src.w, 2 * src.h };
+                    sprite_batch_sprite(&b, &at, LAYER_WORLD, &src, &dst);
+                }
+                sprite_batch_flush(&b);
+                if (p < 0) SDL_RenderFlush(sw);
+                spent += bench_seconds(t0, SDL_GetPerformanceCounter());
+                frames++;
+            }
+            double ms = spent * 1e3 / frames;
+            if (base == 0.0) base = ms;
+            const char *output = "";
+            if (p >= 0 && paths[p].isa == ISA_SCALAR) {
+                memcpy(ref, t.px, sizeof *ref * WIN_W * WIN_H);
+            } else if (p >= 0) {
+                int same = memcmp(ref, t.px, sizeof *ref * WIN_W * WIN_H) == 0;
+                output = same ? "identical" : "MISMATCH";
+                if (!same) failed = 1;
+            }
+            printf("%-9d %-16s %10.3f %7.2fx %s\n", sizes[n], name, ms, base / ms, output);
+            bench_record("soft", "ms/frame", ms, "%s/%d", name, sizes[n]);
+        }
+    }
+
+    sprite_batch_free(&b);
+    soft_free(&t);
+    if (tex) SDL_DestroyTexture(tex);
+    if (sw) SDL_DestroyRenderer(sw);
+    SDL_FreeSurface(screen);
+    SDL_FreeSurface(page);
+    free(ref);
+    return failed;
+}
 
                                                                                                           int main(int argc, char **argv) {
-                                                                                                              (void)argc; (void)argv;
+                                                                                                              Uint64 t_launch = SDL_GetPerformanceCounter();
+
+                                                                                                              // Sprites are prepared at 2x on HiDPI displays; --hidpi forces it.
+                                                                                                              // --mem-report prints asset and process memory at startup and exit.
+                                                                                                              // --startup-time prints how long it took to reach the first game frame.
+                                                                                                              // --no-audio-cache decodes the sound effects on every launch.
+                                                                                                              // --fps N turns vsync off and paces frames to N per second (0: uncapped).
+                                                                                                              // --birds N sends waves of N vultures instead of one.
+                                                                                                              // --draw-stats prints draw calls and vertices per frame every second.
+                                                                                                              // --stats prints a frame-time histogram on exit; --trace out.json writes
+                                                                                                              // every frame phase as a Chrome / Perfetto trace.
+                                                                                                              // --cpu-usage prints the CPU load of each screen, and of play and pause.
+                                                                                                              // --low-latency mixes sound effects on a small audio buffer; --audio-buffer N
+                                                                                                              // sets the buffer size in frames; --audio-stats reports click-to-sound
+                                                                                                              // latency and underruns on exit.
+                                                                                                              // --no-sim-thread runs the simulation on the main thread, between frames.
+                                                                                                              // --fullscreen fills the screen, with the game scaled up to fit.
+                                                                                                              // --frame-budget MS lowers resolution and quality to keep frames within MS.
+                                                                                                              // --bench-out FILE, before a --bench-* mode, appends its results to FILE
+                                                                                                              // as JSON lines.
+                                                                                                              // --hot-reload reloads a sprite or sound effect in the running game when its
+                                                                                                              // file changes.
+                                                                                                              int sprite_scale = 0, mem_report_on = 0, startup_time_on = 0, audio_cache_on = 1;
+                                                                                                              int fps_cap = -1, level_birds = 1, draw_stats_on = 0, stats_on = 0, cpu_usage_on = 0;
+                                                                                                              int low_latency_on = 0, audio_stats_on = 0, audio_frames = 0, sim_thread_on = 1;
+                                                                                                              int fullscreen_on = 0, hot_reload_on = 0;
+                                                                                                              double frame_budget = 0.0;
+                                                                                                              const char *trace_path = NULL;
+                                                                                                              for (int i = 1; i < argc; i++) {
+                                                                                                                  if (strcmp(argv[i], "--hidpi") == 0)          sprite_scale    = 2;
+                                                                                                                  if (strcmp(argv[i], "--mem-report") == 0)     mem_report_on   = 1;
+                                                                                                                  if (strcmp(argv[i], "--startup-time") == 0)   startup_time_on = 1;
+                                                                                                                  if (strcmp(argv[i], "--no-audio-cache") == 0) audio_cache_on  = 0;
+                                                                                                                  if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) fps_cap = atoi(argv[++i]);
+                                                                                                                  if (strcmp(argv[i], "--draw-stats") == 0) draw_stats_on = 1;
+                                                                                                                  if (strcmp(argv[i], "--stats") == 0)      stats_on      = 1;
+                                                                                                                  if (strcmp(argv[i], "--cpu-usage") == 0)  cpu_usage_on  = 1;
+                                                                                                                  if (strcmp(argv[i], "--low-latency") == 0)  low_latency_on = 1;
+                                                                                                                  if (strcmp(argv[i], "--audio-stats") == 0)  audio_stats_on = 1;
+                                                                                                                  if (strcmp(argv[i], "--audio-buffer") == 0 && i + 1 < argc) audio_frames = atoi(argv[++i]);
+                                                                                                                  if (strcmp(argv[i], "--no-sim-thread") == 0) sim_thread_on = 0;
+                                                                                                                  if (strcmp(argv[i], "--fullscreen") == 0)    fullscreen_on = 1;
+                                                                                                                  if (strcmp(argv[i], "--hot-reload") == 0)    hot_reload_on = 1;
+                                                                                                                  if (strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc) frame_budget = atof(argv[++i]);
+                                                                                                                  if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace_path = argv[++i];
+                                                                                                                  if (strcmp(argv[i], "--bench-out") == 0 && i + 1 < argc) {
+                                                                                                                      bench_out = fopen(argv[++i], "a");
+                                                                                                                      if (!bench_out) fprintf(stderr, "Warning: cannot write %s\n", argv[i]);
+                                                                                                                  }
+                                                                                                                  if (strcmp(argv[i], "--birds") == 0 && i + 1 < argc) {
+                                                                                                                      level_birds = atoi(argv[++i]);
+                                                                                                                      if (level_birds < 1) level_birds = 1;
+                                                                                                                      if (level_birds > SIM_MAX_BIRDS) level_birds = SIM_MAX_BIRDS;
+                                                                                                                  }
+                                                                                                              }
+                                                                                                              if (audio_frames <= 0)
+                                                                                                                  audio_frames = low_latency_on ? SFX_LOW_LATENCY_FRAMES : SFX_DEFAULT_FRAMES;
+
+                                                                                                              // Command-line modes that don't open the game window
+                                                                                                              for (int i = 1; i < argc; i++) {
+                                                                                                                  if (strcmp(argv[i], "--bake") == 0)
+                                                                                                                      return bake_sprites(sprite_scale ? sprite_scale : 1);
+                                                                                                                  if (strcmp(argv[i], "--bench-load") == 0)
+                                                                                                                      return bench_load(sprite_scale ? sprite_scale : 1);
+                                                                                                                  if (strcmp(argv[i], "--bench-desblend") == 0)
+                                                                                                                      return bench_desblend(i + 1 < argc ? argv[i + 1] : "bu1.png");
+                                                                                                                  if (strcmp(argv[i], "--bench-sim") == 0)
+                                                                                                                      return bench_sim(i + 1 < argc ? atof(argv[i + 1]) : 120.0,
+                                                                                                                                       i + 2 < argc ? argv[i + 2] : NULL, level_birds);
+                                                                                                                  if (strcmp(argv[i], "--bench-entities") == 0)
+                                                                                                                      return bench_entities(i + 1 < argc ? atoi(argv[i + 1]) : 1000,
+                                                                                                                                            i + 2 < argc ? atof(argv[i + 2]) : 10.0);
+                                                                                                                  if (strcmp(argv[i], "--bench-collide") == 0)
+                                                                                                                      return bench_collide();
+                                                                                                                  if (strcmp(argv[i], "--bench-mask") == 0)
+                                                                                                                      return bench_mask(i + 1 < argc ? argv[i + 1] : "bu1.png");
+                                                                                                                  if (strcmp(argv[i], "--bench-batch") == 0)
+                                                                                                                      return bench_batch();
+                                                                                                                  if (strcmp(argv[i], "--bench-particles") == 0)
+                                                                                                                      return bench_particles(i + 1 < argc ? atoi(argv[i + 1]) : 0);
+                                                                                                                  if (strcmp(argv[i], "--bench-soft") == 0)
+                                                                                                                      return bench_soft();
+                                                                                                                  if (strcmp(argv[i], "--render-png") == 0 && i + 1 < argc)
+                                                                                                                      return render_png(argv[i + 1], i + 2 < argc ? atof(argv[i + 2]) : 3.0,
+                                                                                                                                        i + 3 < argc && strcmp(argv[i + 3], "bilinear") == 0
+                                                                                                                                        ? SOFT_BILINEAR : SOFT_NEAREST, level_birds);
+                                                                                                              }
 
-                                                                                                              // 1) Display the splash and shut down its SDL/IMG subsystems
-                                                                                                              show_splash();
+                                                                                                              // Everything the game loop draws and plays, loaded from step 3 on
+                                                                                                              GameAssets  assets;
+                                                                                                              AssetLoader loader;
+                                                                                                              SDL_zero(assets);
+                                                                                                              SDL_zero(loader);
 
-                                                                                                              // 2) Initialize SDL for video, timers, and audio
+                                                                                                              // 1) Initialize SDL for video, timers, and audio, once for the whole run
                                                                                                               if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_AUDIO) != 0) {
                                                                                                                   fprintf(stderr, "SDL_Init: %s\n", SDL_GetError());
                                                                                                                   return 1;
@@ -217,24 +4738,60 @@ static void sample_corners_color(SDL_Surface* s,
                                                                                                               if ((Mix_Init(mix_flags) & mix_flags) != mix_flags) {
                                                                                                                   fprintf(stderr, "Warning: Mix_Init MP3: %s\n", Mix_GetError());
                                                                                                               }
-                                                                                                              if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
+                                                                                                              if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, audio_frames) < 0) {
                                                                                                                   fprintf(stderr, "Mix_OpenAudio: %s\n", Mix_GetError());
+                                                                                                              } else {
+                                                                                                                  sfx_open(low_latency_on, audio_stats_on);
                                                                                                               }
 
-                                                                                                              // 3) Create the main window and renderer for entry and game
+                                                                                                              // 2) Create the window and renderer for splash, entry and game
                                                                                                               SDL_Window   *win = SDL_CreateWindow("Aeroboo",
-                                                                                                                                                   SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                                                                                                                                                   WIN_W, WIN_H, 0);
+                                                                                                                                                  SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                                                                                                                                  WIN_W, WIN_H, SDL_WINDOW_ALLOW_HIGHDPI |
+                                                                                                                                                  (fullscreen_on ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0));
                                                                                                               SDL_Renderer *ren = SDL_CreateRenderer(win, -1,
-                                                                                                                                                     SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+                                                                                                                                                     SDL_RENDERER_ACCELERATED |
+                                                                                                                                                     (fps_cap < 0 ? SDL_RENDERER_PRESENTVSYNC : 0));
+                                                                                                              if (win && !ren) {
+                                                                                                                  // No GPU: SDL's software renderer still shows the game
+                                                                                                                  fprintf(stderr, "Warning: no accelerated renderer (%s), drawing in software\n",
+                                                                                                                          SDL_GetError());
+                                                                                                                  ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_SOFTWARE);
+                                                                                                              }
                                                                                                               if (!win || !ren) {
                                                                                                                   fprintf(stderr, "Window/Ren error: %s\n", SDL_GetError());
                                                                                                                   goto CLEANUP;
                                                                                                               }
 
-                                                                                                              // 4) Entry screen: load background image and mascot sprite, start music
-                                                                                                              SDL_Texture *entry_bg   = IMG_LoadTexture(ren, SPLASH_IMG);
-                                                                                                              SDL_Texture *entry_masc = IMG_LoadTexture(ren, ENTRY_IMG);
+                                                                                                              // Keep game coordinates in WIN_W x WIN_H whatever the pixel density
+                                                                                                              SDL_RenderSetLogicalSize(ren, WIN_W, WIN_H);
+                                                                                                              if (!sprite_scale) {
+                                                                                                                  int out_w = WIN_W;
+                                                                                                                  SDL_GetRendererOutputSize(ren, &out_w, NULL);
+                                                                                                                  sprite_scale = out_w >= 2 * WIN_W ? 2 : 1;
+                                                                                                              }
+
+                                                                                                              // 3) Decode and process all game assets in the background from here on
+                                                                                                              assets_load_begin(&loader, sprite_scale, SPRITE_KEEP_NONE, audio_cache_on);
+
+                                                                                                              // 4) Splash screen, whose image is also the entry screen background
+                                                                                                              SDL_Texture *entry_bg = IMG_LoadTexture(ren, SPLASH_IMG);
+                                                                                                              double cpu_mark  = 0.0;
+                                                                                                              Uint64 cpu_since = t_launch;
+                                                                                                              if (cpu_usage_on) cpu_report("startup", &cpu_mark, &cpu_since);
+                                                                                                              if (show_splash(ren, entry_bg)) {
+                                                                                                                  if (entry_bg) SDL_DestroyTexture(entry_bg);
+                                                                                                                  goto CLEANUP;
+                                                                                                              }
+                                                                                                              if (cpu_usage_on) cpu_report("splash", &cpu_mark, &cpu_since);
+
+                                                                                                              // 5) Entry screen: mascot sprite from the loader, start music
+                                                                                                              SDL_Texture *entry_masc = NULL;
+                                                                                                              SDL_Surface *masc_surf  = assets_load_mascot(&loader);
+                                                                                                              if (masc_surf) {
+                                                                                                                  entry_masc = SDL_CreateTextureFromSurface(ren, masc_surf);
+                                                                                                                  SDL_FreeSurface(masc_surf);
+                                                                                                              }
                                                                                                               Mix_Music   *entry_mus  = Mix_LoadMUS(ENTRY_MUSIC_FILE);
                                                                                                               if (!entry_bg || !entry_masc) {
                                                                                                                   fprintf(stderr, "Error: failed to load entry assets (splash/vulture)\n");
@@ -254,11 +4811,21 @@ static void sample_corners_color(SDL_Surface* s,
                                                                                                               // Play entry music in loop
                                                                                                               if (entry_mus) Mix_PlayMusic(entry_mus, -1);
 
-                                                                                                              // Wait for mouse click or quit event
-                                                                                                              int entryRunning = 1, quitAll = 0;
+                                                                                                              // Wait for mouse click or quit event. Nothing on the entry screen moves,
+                                                                                                              // so it is drawn only when the window needs it and the loop sleeps in
+                                                                                                              // between
+                                                                                                              int entryRunning = 1, quitAll = 0, redraw = 1;
                                                                                                               while (entryRunning) {
+                                                                                                                  if (redraw) {
+                                                                                                                      SDL_RenderClear(ren);
+                                                                                                                      if (entry_bg)   SDL_RenderCopy(ren, entry_bg,   NULL, NULL);
+                                                                                                                      if (entry_masc) SDL_RenderCopy(ren, entry_masc, NULL, &dstMas);
+                                                                                                                      SDL_RenderPresent(ren);
+                                                                                                                      redraw = 0;
+                                                                                                                  }
                                                                                                                   SDL_Event e;
-                                                                                                                  while (SDL_PollEvent(&e)) {
+                                                                                                                  if (!SDL_WaitEvent(&e)) continue;
+                                                                                                                  do {
                                                                                                                       if (e.type == SDL_QUIT) {
                                                                                                                           entryRunning = 0;
                                                                                                                           quitAll = 1;
@@ -266,13 +4833,10 @@ static void sample_corners_color(SDL_Surface* s,
                                                                                                                       if (e.type == SDL_MOUSEBUTTONDOWN) {
                                                                                                                           entryRunning = 0;
                                                                                                                       }
-                                                                                                                  }
-                                                                                                                  SDL_RenderClear(ren);
-                                                                                                                  if (entry_bg)   SDL_RenderCopy(ren, entry_bg,   NULL, NULL);
-                                                                                                                  if (entry_masc) SDL_RenderCopy(ren, entry_masc, NULL, &dstMas);
-                                                                                                                  SDL_RenderPresent(ren);
-                                                                                                                  SDL_Delay(16);
+                                                                                                                      redraw |= event_needs_redraw(&e);
+                                                                                                                  } while (SDL_PollEvent(&e));
                                                                                                               }
+                                                                                                              if (cpu_usage_on) cpu_report("entry", &cpu_mark, &cpu_since);
 
                                                                                                               // Stop music and free entry resources
                                                                                                               Mix_HaltMusic();
@@ -285,293 +4849,255 @@ static void sample_corners_color(SDL_Surface* s,
                                                                                                                   goto CLEANUP;
                                                                                                               }
 
-                                                                                                              // 5) Prepare for the main game loop: load assets and initialize state
-
-                                                                                                              // Music and sound effects
-                                                                                                              Mix_Music *music_vulture = Mix_LoadMUS("vulture.mp3");
-                                                                                                              if (!music_vulture) {
-                                                                                                                  music_vulture = Mix_LoadMUS("vulture.wav");
-                                                                                                              }
-                                                                                                              Mix_Chunk *sfx_canon     = Mix_LoadWAV("canon.mp3");
-                                                                                                              if (!sfx_canon)     sfx_canon     = Mix_LoadWAV("canon.wav");
-                                                                                                              Mix_Chunk *sfx_explosion = Mix_LoadWAV("explosion.mp3");
-                                                                                                              if (!sfx_explosion) sfx_explosion = Mix_LoadWAV("explosion.wav");
-                                                                                                              Mix_Chunk *sfx_winner    = Mix_LoadWAV("win.mp3");
-                                                                                                              if (!sfx_winner) {
-                                                                                                                  sfx_winner = Mix_LoadWAV("win.wav");
-                                                                                                                  if (!sfx_winner) {
-                                                                                                                      fprintf(stderr, "Warning: failed to load win.mp3/.wav: %s\n", Mix_GetError());
-                                                                                                                  }
-                                                                                                              }
-
-                                                                                                              // Bird sprites
-                                                                                                              SDL_Surface *s_bu1 = NULL, *s_bu2 = NULL;
-                                                                                                              SDL_Texture *t_bu1 = load_and_process_texture(ren, "bu1.png", &s_bu1);
-                                                                                                              SDL_Texture *t_bu2 = load_and_process_texture(ren, "bu2.png", &s_bu2);
-
-                                                                                                              // Cannon frames
-                                                                                                              SDL_Surface *s_c[CANNON_FRAMES] = {0};
-                                                                                                              SDL_Texture *t_c[CANNON_FRAMES] = {0};
-                                                                                                              const char* cf[CANNON_FRAMES] = {"cano1.png","cano2.png","cano3.png"};
-                                                                                                              for (int i = 0; i < CANNON_FRAMES; i++) {
-                                                                                                                  t_c[i] = load_and_process_texture(ren, cf[i], &s_c[i]);
-                                                                                                              }
+                                                                                                              // 6) Prepare for the main game loop: wait for the loader (normally done
+                                                                                                              // long ago), upload the atlas and initialize state
+                                                                                                              Uint64 t_click = SDL_GetPerformanceCounter();
+                                                                                                              assets_load_finish(&loader, ren, &assets);
+                                                                                                              if (mem_report_on) mem_report("startup", &assets);
 
-                                                                                                              // Explosion and winner images
-                                                                                                              SDL_Surface *s_exp = NULL, *s_win = NULL;
-                                                                                                              SDL_Texture *t_exp = load_and_process_texture(ren, "explosion.png", &s_exp);
-                                                                                                              SDL_Texture *t_win = load_and_process_texture(ren, "winner.png", &s_win);
-                                                                                                              int win_w = 0, win_h = 0;
-                                                                                                              if (t_win) SDL_QueryTexture(t_win, NULL, NULL, &win_w, &win_h);
+                                                                                                              const SpriteAtlas *atlas = &assets.atlas;
 
                                                                                                               // Fallback background color if corner sampling fails
-                                                                                                              const Uint8 bg_fallback[3] = {135,206,235};
+                                                                                                              const Uint8 bg_fallback[3] = { SKY_COLOR.r, SKY_COLOR.g, SKY_COLOR.b };
                                                                                                               Uint8 bg_r = bg_fallback[0],
                                                                                                               bg_g = bg_fallback[1],
                                                                                                               bg_b = bg_fallback[2];
 
-                                                                                                              // Bird animation parameters
-                                                                                                              int bw, bh;
-                                                                                                              SDL_QueryTexture(t_bu1, NULL, NULL, &bw, &bh);
-                                                                                                              float bs = 128.f / (float)bw;
-                                                                                                              bw = (int)(bw * bs + .5f);
-                                                                                                              bh = (int)(bh * bs + .5f);
-                                                                                                              float bird_x     = WIN_W + 10, bird_y = 12;
-                                                                                                              float bird_vx    = 180.f;
-                                                                                                              int   bird_frame = 0, bird_active = 1;
-                                                                                                              const double bird_frametime = 0.18;
-                                                                                                              double bird_acc = 0.0;
-
-                                                                                                              // Cannon positioning and animation state
-                                                                                                              int cw, ch;
-                                                                                                              SDL_QueryTexture(t_c[0], NULL, NULL, &cw, &ch);
-                                                                                                              float cs = (192.f / (float)cw) * 0.5f;
-                                                                                                              cw = (int)(cw * cs + .5f);
-                                                                                                              ch = (int)(ch * cs + .5f);
-                                                                                                              float cx = (WIN_W - cw) / 2.f,
-                                                                                                              cy = WIN_H - ch - 8;
-                                                                                                              int canon_play  = 0, canon_frame = 0, proj_spawn = 0;
-                                                                                                              double canon_acc = 0.0;
-
-                                                                                                              // Projectile state
-                                                                                                              int   proj_active = 0;
-                                                                                                              float proj_x = 0, proj_y = 0;
-                                                                                                              const int pw = 10, ph = 10;
-
-                                                                                                              // Explosion state
-                                                                                                              int   exp_active = 0;
-                                                                                                              float exp_x = 0, exp_y = 0;
-                                                                                                              double exp_timer = 0.0;
-
-                                                                                                              // Winner display state
-                                                                                                              int    winner_active = 0;
-                                                                                                              double winner_timer  = 0.0;
+                                                                                                              // Game state, advanced in fixed steps, and the three snapshots it is drawn
+                                                                                                              // from (static: the pools are too big for the stack)
+                                                                                                              static SimState sim, sim_view[3];
+                                                                                                              sim_init_for_atlas(&sim, atlas, level_birds);
+
+                                                                                                              // Pixel-accurate hits when the masks match the size the birds are drawn at
+                                                                                                              for (int f = 0; f < 2; f++) {
+                                                                                                                  const CollisionMask *m = &assets.bird_mask[f];
+                                                                                                                  if (m->bits && m->w == (int)sim.bw && m->h == (int)sim.bh) sim.bird_mask[f] = m;
+                                                                                                              }
+
+                                                                                                              // Frame pacing. With vsync, presenting paces the loop by itself; without
+                                                                                                              // it the loop sleeps to the --fps rate, or to the display rate if vsync
+                                                                                                              // was asked for but the driver did not give it. --fps 0 runs uncapped.
+                                                                                                              Uint64 freq64 = SDL_GetPerformanceFrequency();
+                                                                                                              double freq   = (double)freq64;
+                                                                                                              Uint64 frame_ticks = 0;
+                                                                                                              if (fps_cap > 0) {
+                                                                                                                  frame_ticks = freq64 / (Uint64)fps_cap;
+                                                                                                              } else if (fps_cap < 0) {
+                                                                                                                  SDL_RendererInfo rinfo;
+                                                                                                                  if (SDL_GetRendererInfo(ren, &rinfo) != 0 ||
+                                                                                                                      !(rinfo.flags & SDL_RENDERER_PRESENTVSYNC)) {
+                                                                                                                      SDL_DisplayMode dm;
+                                                                                                                      int hz = 60;
+                                                                                                                      if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(win), &dm) == 0 &&
+                                                                                                                          dm.refresh_rate > 0)
+                                                                                                                          hz = dm.refresh_rate;
+                                                                                                                      frame_ticks = freq64 / (Uint64)hz;
+                                                                                                                  }
+                                                                                                              }
+
+                                                                                                              // Frame quads, and the counters --draw-stats prints
+                                                                                                              SpriteBatch batch;
+                                                                                                              SDL_zero(batch);
+                                                                                                              int    stat_frames = 0;
+                                                                                                              long   stat_calls = 0, stat_verts = 0, stat_quads = 0;
+                                                                                                              double stat_px = 0.0, stat_trimmed = 0.0;
+                                                                                                              Uint64 stat_t0 = SDL_GetPerformanceCounter();
 
                                                                                                               // Timing setup
-                                                                                                              Uint64 last = SDL_GetPerformanceCounter();
-                                                                                                              double freq = (double)SDL_GetPerformanceFrequency();
+                                                                                                              Uint64 next_frame = SDL_GetPerformanceCounter();
+                                                                                                              float alpha = 0.f;
                                                                                                               int running = 1, paused = 0;
 
-                                                                                                              // Start vulture music if bird is active
-                                                                                                              if (music_vulture && bird_active && !exp_active) {
-                                                                                                                  Mix_PlayMusic(music_vulture, -1);
-                                                                                                                  Mix_VolumeMusic(MIX_MAX_VOLUME * 60 / 100);
+                                                                                                              // Profile the whole run if asked to; F3 can also start it later
+                                                                                                              if (stats_on || trace_path) prof_start(trace_path);
+
+                                                                                                              // Trade quality for frame rate if asked to (--frame-budget)
+                                                                                                              if (frame_budget > 0.0) {
+                                                                                                                  gov_start(frame_budget);
+                                                                                                                  SDL_SetTextureScaleMode(atlas->tex, SDL_ScaleModeLinear);
                                                                                                               }
 
-                                                                                                              // 6) Main game loop
+                                                                                                              // Start stepping, and the vulture music if birds are flying
+                                                                                                              SimRunner runner;
+                                                                                                              sim_runner_start(&runner, &sim, sim_view, &assets, sim_thread_on);
+                                                                                                              if (hot_reload_on) hot_start(sprite_scale);
+
+                                                                                                              // 7) Main game loop. While paused, with nothing else moving on screen,
+                                                                                                              // frames are neither drawn nor presented: the loop sleeps until an
+                                                                                                              // event, and draws again only after one that changes the picture
+                                                                                                              redraw = 1;
                                                                                                               while (running) {
                                                                                                                   SDL_Event e;
-                                                                                                                  while (SDL_PollEvent(&e)) {
+                                                                                                                  int got = 0;
+                                                                                                                  if (paused && !prof.hud && !redraw) {
+                                                                                                                      got = SDL_WaitEvent(&e);
+                                                                                                                      prof_frame_drop();
+                                                                                                                  }
+                                                                                                                  Uint64 t_work = SDL_GetPerformanceCounter();
+                                                                                                                  PROF_BEGIN(PROF_EVENTS);
+                                                                                                                  for (got = got || SDL_PollEvent(&e); got; got = SDL_PollEvent(&e)) {
                                                                                                                       if (e.type == SDL_QUIT) {
                                                                                                                           running = 0;
                                                                                                                       }
                                                                                                                       else if (e.type == SDL_KEYDOWN) {
                                                                                                                           if (e.key.keysym.sym == SDLK_ESCAPE) running = 0;
-                                                                                                                          if (e.key.keysym.sym == SDLK_SPACE)  paused = !paused;
-                                                                                                                      }
-                                                                                                                      else if (e.type == SDL_MOUSEBUTTONDOWN &&
-                                                                                                                          e.button.button == SDL_BUTTON_LEFT) {
-                                                                                                                          if (!canon_play) {
-                                                                                                                              canon_play  = 1;
-                                                                                                                              canon_acc   = 0.0;
-                                                                                                                              canon_frame = 0;
-                                                                                                                              proj_spawn  = 0;
+                                                                                                                          if (e.key.keysym.sym == SDLK_SPACE) {
+                                                                                                                              if (cpu_usage_on)
+                                                                                                                                  cpu_report(paused ? "paused" : "playing", &cpu_mark, &cpu_since);
+                                                                                                                              sim_runner_send(&runner, SIM_MSG_PAUSE,
+                                                                                                                                              event_counter(&e, SDL_GetPerformanceCounter()));
+                                                                                                                              paused = !paused;
+                                                                                                                              redraw = 1;
                                                                                                                           }
+                                                                                                                          if (e.key.keysym.sym == SDLK_F3) {
+                                                                                                                              prof.hud = !prof.hud;
+                                                                                                                              if (prof.hud && !prof.on) prof_start(NULL);
+                                                                                                                              redraw = 1;
                                                                                                                           }
+                                                                                                                      }
+                                                                                                                      else if (e.type == SDL_MOUSEBUTTONDOWN &&
+                                                                                                                               e.button.button == SDL_BUTTON_LEFT) {
+                                                                                                                          sim_runner_send(&runner, SIM_MSG_FIRE,
+                                                                                                                                          event_counter(&e, SDL_GetPerformanceCounter()));
+                                                                                                                      }
+                                                                                                                      redraw |= event_needs_redraw(&e);
                                                                                                                   }
+                                                                                                                  PROF_END(PROF_EVENTS);
 
-                                                                                                                  Uint64 now = SDL_GetPerformanceCounter();
-                                                                                                                  double dt  = (now - last) / freq;
-                                                                                                                  last = now;
+                                                                                                                  // Without its own thread the simulation catches up here
+                                                                                                                  if (!runner.thread) sim_runner_advance(&runner, SDL_GetPerformanceCounter());
+                                                                                                                  sim_runner_prof(&runner);
 
-                                                                                                                  if (!paused) {
-                                                                                                                      // Update bird position and frame
-                                                                                                                      if (bird_active && !exp_active) {
-                                                                                                                          bird_x -= bird_vx * (float)dt;
-                                                                                                                          if (bird_x < -bw - 10) bird_x = WIN_W + 10;
-                                                                                                                          bird_acc += dt;
-                                                                                                                          if (bird_acc >= bird_frametime) {
-                                                                                                                              bird_acc -= bird_frametime;
-                                                                                                                              bird_frame ^= 1;
-                                                                                                                          }
-                                                                                                                      }
+                                                                                                                  // A changed asset, reloaded in the background, is swapped in here
+                                                                                                                  redraw |= hot_apply(ren, &assets);
 
-                                                                                                                      // Manage bird music playback
-                                                                                                                      if (bird_active && !exp_active) {
-                                                                                                                          if (music_vulture && Mix_PlayingMusic() == 0)
-                                                                                                                              Mix_PlayMusic(music_vulture, -1);
-                                                                                                                      } else {
-                                                                                                                          if (Mix_PlayingMusic() != 0)
-                                                                                                                              Mix_HaltMusic();
-                                                                                                                      }
+                                                                                                                  // The last frame presented still holds
+                                                                                                                  if (paused && !prof.hud && !redraw) continue;
+                                                                                                                  redraw = 0;
 
-                                                                                                                      // Animate cannon firing
-                                                                                                                      if (canon_play) {
-                                                                                                                          canon_acc += dt;
-                                                                                                                          if (canon_acc >= CANNON_FRAME_TIME) {
-                                                                                                                              canon_acc  -= CANNON_FRAME_TIME;
-                                                                                                                              canon_frame++;
-                                                                                                                              if (canon_frame >= CANNON_FRAMES) {
-                                                                                                                                  canon_play  = 0;
-                                                                                                                                  canon_frame = 0;
-                                                                                                                                  proj_spawn  = 0;
-                                                                                                                              }
-                                                                                                                          }
-                                                                                                                          if (canon_frame == CANNON_FRAMES - 1 && !proj_spawn) {
-                                                                                                                              proj_active = 1;
-                                                                                                                              proj_x = cx + cw * 0.5f - pw * 0.5f;
-                                                                                                                              proj_y = cy + ch * 0.15f;
-                                                                                                                              proj_spawn = 1;
-                                                                                                                              if (sfx_canon) Mix_PlayChannel(-1, sfx_canon, 0);
-                                                                                                                          }
-                                                                                                                      }
+                                                                                                                  // Draw the newest snapshot between its last two steps, by how far real
+                                                                                                                  // time has got past it (frozen while paused)
+                                                                                                                  Uint64 t_view;
+                                                                                                                  const SimState *view = sim_runner_latest(&runner, &t_view);
+                                                                                                                  if (!paused) {
+                                                                                                                      alpha = (float)(((double)SDL_GetPerformanceCounter() - (double)t_view) / freq / SIM_DT);
+                                                                                                                      if (alpha < 0.f) alpha = 0.f;
+                                                                                                                      if (alpha > 1.f) alpha = 1.f;
+                                                                                                                  }
 
-                                                                                                                      // Update projectile movement and collisions
-                                                                                                                      if (proj_active) {
-                                                                                                                          proj_y -= PROJECTILE_SPEED * (float)dt;
-                                                                                                                          if (proj_y + ph < -50) proj_active = 0;
-                                                                                                                          if (bird_active && !exp_active &&
-                                                                                                                              rects_intersectf(proj_x, proj_y, pw, ph,
-                                                                                                                                               bird_x, bird_y, bw, bh)) {
-                                                                                                                              proj_active = 0;
-                                                                                                                          exp_active  = 1;
-                                                                                                                          exp_x       = bird_x;
-                                                                                                                          exp_y       = bird_y;
-                                                                                                                          exp_timer   = EXPLOSION_TIME;
-                                                                                                                          bird_active = 0;
-                                                                                                                          if (sfx_explosion) Mix_PlayChannel(-1, sfx_explosion, 0);
-                                                                                                                          if (Mix_PlayingMusic() != 0) Mix_HaltMusic();
-
-                                                                                                                          winner_active = 1;
-                                                                                                                              winner_timer  = WINNER_TIME;
-                                                                                                                              if (sfx_winner) Mix_PlayChannel(-1, sfx_winner, 0);
-                                                                                                                                               }
-                                                                                                                      }
+                                                                                                                  // Rendering: every quad goes through the sprite batch, sent at the end
+                                                                                                                  PROF_BEGIN(PROF_DRAW);
+                                                                                                                  sprite_batch_begin(&batch, ren);
 
-                                                                                                                      // Countdown explosion duration
-                                                                                                                      if (exp_active) {
-                                                                                                                          exp_timer -= dt;
-                                                                                                                          if (exp_timer <= 0.0) exp_active = 0;
-                                                                                                                      }
+                                                                                                                  sim_draw(view, &batch, atlas, alpha, GOV_LEVELS[gov.level].spark_stride);
+                                                                                                                  if (prof.hud) prof_draw_hud(&batch, atlas);
+                                                                                                                  PROF_END(PROF_DRAW);
 
-                                                                                                                      // Countdown winner display duration
-                                                                                                                      if (winner_active) {
-                                                                                                                          winner_timer -= dt;
-                                                                                                                          if (winner_timer <= 0.0) {
-                                                                                                                              winner_active = 0;
-                                                                                                                              bird_active   = 1;
-                                                                                                                              bird_x        = WIN_W + 10;
-                                                                                                                              bird_frame    = 0;
-                                                                                                                              bird_acc      = 0.0;
-                                                                                                                              if (music_vulture)
-                                                                                                                                  Mix_PlayMusic(music_vulture, -1);
-                                                                                                                          }
-                                                                                                                      }
+                                                                                                                  // Below full resolution the frame is drawn into a smaller texture, then
+                                                                                                                  // scaled up to the window
+                                                                                                                  PROF_BEGIN(PROF_SUBMIT);
+                                                                                                                  SDL_Texture *rt = gov.on ? gov_target(ren) : NULL;
+                                                                                                                  if (rt) {
+                                                                                                                      SDL_SetRenderTarget(ren, rt);
+                                                                                                                      SDL_RenderSetScale(ren, (float)gov.rt_w / WIN_W, (float)gov.rt_h / WIN_H);
                                                                                                                   }
-
-                                                                                                                  // Rendering
                                                                                                                   SDL_SetRenderDrawColor(ren, bg_r, bg_g, bg_b, 255);
                                                                                                                   SDL_RenderClear(ren);
-
-                                                                                                                  if (winner_active && t_win) {
-                                                                                                                      // Draw "WINNER" centered on screen
-                                                                                                                      int dw = win_w, dh = win_h;
-                                                                                                                      const int TW = 400;
-                                                                                                                      if (win_w > TW) {
-                                                                                                                          float sc = (float)TW / (float)win_w;
-                                                                                                                          dw = (int)(win_w * sc + 0.5f);
-                                                                                                                          dh = (int)(win_h * sc + 0.5f);
-                                                                                                                      }
-                                                                                                                      SDL_Rect rw = { (WIN_W - dw) / 2, (WIN_H - dh) / 2, dw, dh };
-                                                                                                                      SDL_RenderCopy(ren, t_win, NULL, &rw);
+                                                                                                                  sprite_batch_flush(&batch);
+                                                                                                                  if (rt) {
+                                                                                                                      SDL_SetRenderTarget(ren, NULL);
+                                                                                                                      SDL_RenderClear(ren);
+                                                                                                                      SDL_RenderCopy(ren, rt, NULL, NULL);
                                                                                                                   }
-                                                                                                                  else {
-                                                                                                                      // Draw explosion, bird, or cannon + projectile
-                                                                                                                      if (exp_active) {
-                                                                                                                          SDL_Rect re = { (int)(exp_x + 0.5f),
-                                                                                                                              (int)(exp_y + 0.5f),
-                                                                                                                              bw, bh };
-                                                                                                                              SDL_RenderCopy(ren, t_exp, NULL, &re);
-                                                                                                                      }
-                                                                                                                      else if (bird_active) {
-                                                                                                                          SDL_Rect rb = { (int)(bird_x + 0.5f),
-                                                                                                                              (int)(bird_y + 0.5f),
-                                                                                                                              bw, bh };
-                                                                                                                              SDL_RenderCopy(ren,
-                                                                                                                                             (bird_frame == 0 ? t_bu1 : t_bu2),
-                                                                                                                                             NULL, &rb);
-                                                                                                                      }
+                                                                                                                  PROF_END(PROF_SUBMIT);
 
-                                                                                                                      int cfidx = (canon_play ? canon_frame : 0);
-                                                                                                                      if (cfidx < 0) cfidx = 0;
-                                                                                                                      if (cfidx >= CANNON_FRAMES) cfidx = CANNON_FRAMES - 1;
-                                                                                                                      SDL_Rect rc = { (int)(cx + 0.5f),
-                                                                                                                          (int)(cy + 0.5f),
-                                                                                                                          cw, ch };
-                                                                                                                          SDL_RenderCopy(ren, t_c[cfidx], NULL, &rc);
-
-                                                                                                                          if (proj_active) {
-                                                                                                                              SDL_Rect rp = {
-                                                                                                                                  (int)(proj_x + 0.5f),
-                                                                                                                                  (int)(proj_y + 0.5f),
-                                                                                                                                  pw, ph
-                                                                                                                              };
-                                                                                                                              SDL_SetRenderDrawColor(ren, 220, 200, 60, 255);
-                                                                                                                              SDL_RenderFillRect(ren, &rp);
-                                                                                                                          }
+                                                                                                                  // Batching counters, averaged over each second (--draw-stats)
+                                                                                                                  if (draw_stats_on) {
+                                                                                                                      stat_frames++;
+                                                                                                                      stat_calls += batch.draw_calls;
+                                                                                                                      stat_verts += batch.vertices;
+                                                                                                                      stat_quads += batch.quads;
+                                                                                                                      stat_px    += batch.pixels;
+                                                                                                                      stat_trimmed += batch.trimmed;
+                                                                                                                      Uint64 t = SDL_GetPerformanceCounter();
+                                                                                                                      if (t - stat_t0 >= freq64) {
+                                                                                                                          printf("draw: %.1f calls, %.0f vertices, %.0f sprites per frame (%d frames)\n",
+                                                                                                                                 (double)stat_calls / stat_frames, (double)stat_verts / stat_frames,
+                                                                                                                                 (double)stat_quads / stat_frames, stat_frames);
+                                                                                                                          printf("draw: %.0f pixels blended per frame, %.0f untrimmed\n",
+                                                                                                                                 stat_px / stat_frames, (stat_px + stat_trimmed) / stat_frames);
+                                                                                                                          fflush(stdout);
+                                                                                                                          stat_frames = 0;
+                                                                                                                          stat_calls = stat_verts = stat_quads = 0;
+                                                                                                                          stat_px = stat_trimmed = 0.0;
+                                                                                                                          stat_t0 = t;
+                                                                                                                      }
                                                                                                                   }
 
+                                                                                                                  Uint64 t_present = SDL_GetPerformanceCounter();
+                                                                                                                  PROF_BEGIN(PROF_PRESENT);
                                                                                                                   SDL_RenderPresent(ren);
-                                                                                                                  SDL_Delay(16);
+                                                                                                                  PROF_END(PROF_PRESENT);
+                                                                                                                  if (gov.on) {
+                                                                                                                      // Time only frames of play; a new level takes effect from the next one
+                                                                                                                      if (paused) {
+                                                                                                                          gov_skip();
+                                                                                                                      } else if (gov_frame(t_work, t_present, SDL_GetPerformanceCounter())) {
+                                                                                                                          SDL_ScaleMode mode = GOV_LEVELS[gov.level].linear ? SDL_ScaleModeLinear
+                                                                                                                                                                            : SDL_ScaleModeNearest;
+                                                                                                                          SDL_SetTextureScaleMode(atlas->tex, mode);
+                                                                                                                          if (gov.rt) SDL_SetTextureScaleMode(gov.rt, mode);
+                                                                                                                      }
+                                                                                                                  }
+                                                                                                                  if (startup_time_on && t_click) {
+                                                                                                                      double f = (double)SDL_GetPerformanceFrequency();
+                                                                                                                      Uint64 t_frame = SDL_GetPerformanceCounter();
+                                                                                                                      printf("startup: assets ready %.1f ms after launch (%.1f ms loading, "
+                                                                                                                             "%.1f ms sound effects, %d of %d decoded; %d of %d sprites processed); "
+                                                                                                                             "first game frame %.1f ms after the click, %.1f ms after launch\n",
+                                                                                                                             (loader.t_done - t_launch) * 1000.0 / f,
+                                                                                                                             (loader.t_done - loader.t_start) * 1000.0 / f,
+                                                                                                                             loader.sfx_ms,
+                                                                                                                             loader.sfx_decoded, SFX_COUNT, loader.sprites_made, SPR_COUNT,
+                                                                                                                             (t_frame - t_click) * 1000.0 / f,
+                                                                                                                             (t_frame - t_launch) * 1000.0 / f);
+                                                                                                                      fflush(stdout);
+                                                                                                                      t_click = 0;
+                                                                                                                  }
+                                                                                                                  // Pace the frame unless vsync does; after falling behind, restart from
+                                                                                                                  // now rather than rushing to catch up
+                                                                                                                  PROF_BEGIN(PROF_PACE);
+                                                                                                                  if (frame_ticks) {
+                                                                                                                      next_frame += frame_ticks;
+                                                                                                                      Uint64 t = SDL_GetPerformanceCounter();
+                                                                                                                      if (next_frame < t) next_frame = t;
+                                                                                                                      else sleep_until(next_frame);
+                                                                                                                  }
+                                                                                                                  PROF_END(PROF_PACE);
+                                                                                                                  prof_frame_end();
                                                                                                               }
+                                                                                                              sim_runner_stop(&runner);
+                                                                                                              gov_stop();
+                                                                                                              sprite_batch_free(&batch);
+                                                                                                              if (cpu_usage_on) cpu_report(paused ? "paused" : "playing", &cpu_mark, &cpu_since);
+                                                                                                              if (stats_on) prof_print_stats();
+                                                                                                              prof_stop();
 
                                                                                                               CLEANUP:
-                                                                                                              // Free audio resources
-                                                                                                              if (music_vulture)   Mix_FreeMusic(music_vulture);
-                                                                                                              if (sfx_canon)       Mix_FreeChunk(sfx_canon);
-                                                                                                              if (sfx_explosion)   Mix_FreeChunk(sfx_explosion);
-                                                                                                              if (sfx_winner)      Mix_FreeChunk(sfx_winner);
+                                                                                                              sfx_close();
+                                                                                                              hot_stop();
+                                                                                                              // Free audio resources, the sprite atlas and any kept surfaces
+                                                                                                              if (loader.pending) assets_load_finish(&loader, NULL, &assets);
+                                                                                                              if (mem_report_on && assets.atlas.tex) mem_report("exit", &assets);
+                                                                                                              assets_free(&assets);
                                                                                                               Mix_CloseAudio();
                                                                                                               Mix_Quit();
 
-                                                                                                              // Destroy textures and free surfaces
-                                                                                                              if (t_win)  SDL_DestroyTexture(t_win);
-                                                                                                              if (s_win)  SDL_FreeSurface(s_win);
-                                                                                                              if (t_exp)  SDL_DestroyTexture(t_exp);
-                                                                                                              if (s_exp)  SDL_FreeSurface(s_exp);
-                                                                                                              for (int i = 0; i < CANNON_FRAMES; i++) {
-                                                                                                                  if (t_c[i]) SDL_DestroyTexture(t_c[i]);
-                                                                                                                  if (s_c[i]) SDL_FreeSurface(s_c[i]);
-                                                                                                              }
-                                                                                                              if (t_bu1) SDL_DestroyTexture(t_bu1);
-                                                                                                              if (t_bu2) SDL_DestroyTexture(t_bu2);
-                                                                                                              if (s_bu1) SDL_FreeSurface(s_bu1);
-                                                                                                              if (s_bu2) SDL_FreeSurface(s_bu2);
-
                                                                                                               // Destroy renderer and window
                                                                                                               if (ren) SDL_DestroyRenderer(ren);
                                                                                                               if (win) SDL_DestroyWindow(win);
 
+                                                                                                              pool_shutdown();
                                                                                                               IMG_Quit();
                                                                                                               SDL_Quit();
                                                                                                               return 0;